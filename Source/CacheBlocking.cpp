@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    CacheBlocking.cpp
+
+    Asks the OS how big the CPU's data caches are. Kept out of the header so
+    that the platform headers it needs don't leak into every file.
+
+  ==============================================================================
+*/
+
+#include "CacheBlocking.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <sys/sysctl.h>
+#elif JUCE_LINUX
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+size_t CacheBlocking::getDataCacheSize()
+{
+    size_t l1 = 0, l2 = 0;
+
+   #if JUCE_WINDOWS
+    DWORD bytes = 0;
+    GetLogicalProcessorInformation (nullptr, &bytes);
+
+    HeapBlock<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info ((size_t) bytes / sizeof (SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+
+    if (bytes > 0 && GetLogicalProcessorInformation (info, &bytes))
+    {
+        for (size_t i = 0; i < bytes / sizeof (SYSTEM_LOGICAL_PROCESSOR_INFORMATION); ++i)
+        {
+            if (info[i].Relationship != RelationCache || info[i].Cache.Type == CacheInstruction)
+                continue;
+
+            if (info[i].Cache.Level == 1)  l1 = jmax (l1, (size_t) info[i].Cache.Size);
+            if (info[i].Cache.Level == 2)  l2 = jmax (l2, (size_t) info[i].Cache.Size);
+        }
+    }
+   #elif JUCE_MAC || JUCE_IOS
+    auto query = [] (const char* name) -> size_t
+    {
+        int64 value = 0;
+        size_t length = sizeof (value);
+        return sysctlbyname (name, &value, &length, nullptr, 0) == 0 && value > 0 ? (size_t) value : 0;
+    };
+
+    // Apple silicon reports the performance cores separately
+    l1 = query ("hw.perflevel0.l1dcachesize");
+    l2 = query ("hw.perflevel0.l2cachesize");
+
+    if (l1 == 0)  l1 = query ("hw.l1dcachesize");
+    if (l2 == 0)  l2 = query ("hw.l2cachesize");
+   #elif JUCE_LINUX
+    auto fromSysfs = [] (int index) -> size_t
+    {
+        const auto text = File ("/sys/devices/system/cpu/cpu0/cache/index" + String (index) + "/size").loadFileAsString().trim();
+        const auto value = (size_t) text.getLargeIntValue();
+        return text.endsWithIgnoreCase ("M") ? value << 20 : text.endsWithIgnoreCase ("K") ? value << 10 : value;
+    };
+
+   #ifdef _SC_LEVEL2_CACHE_SIZE
+    l1 = (size_t) jmax (0L, sysconf (_SC_LEVEL1_DCACHE_SIZE));
+    l2 = (size_t) jmax (0L, sysconf (_SC_LEVEL2_CACHE_SIZE));
+   #endif
+
+    // index0 is L1d and index2 is L2 on every layout the kernel currently reports
+    if (l1 == 0)  l1 = fromSysfs (0);
+    if (l2 == 0)  l2 = fromSysfs (2);
+   #endif
+
+    if (l2 > 0)  return l2;
+    if (l1 > 0)  return l1 * 8;
+
+    return 256 * 1024;
+}
@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    CacheBlocking.h
+
+    Works out how many samples the processor can push through all of its
+    stages at once while the audio stays in the CPU's data caches.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+ Chooses the chunk size for cache-blocked processing.
+
+ Offline bounces can hand processBlock() tens of thousands of samples at once. If the
+ reverb runs over all of them and the filter then runs over them again, the buffer has
+ long since left L1/L2 by the time the second stage reaches it. Instead the processor
+ runs every stage over one chunk before moving to the next, and getChunkSize() picks
+ the largest chunk whose audio, together with the stretch of each delay line it passes
+ through, still fits comfortably in the per-core L2 cache.
+ */
+struct CacheBlocking
+{
+    enum
+    {
+        minChunkSize = 256,     /**< Below this the per-chunk overhead starts to show. */
+        maxChunkSize = 8192,    /**< Beyond this there's nothing left to gain. */
+        chunkAlignment = 64     /**< Keeps every chunk boundary on a whole number of cache lines. */
+    };
+
+    /** Returns the size in bytes of the L2 data cache (or L1 if there is no L2 information),
+     or 256 KB if the platform won't say. Not realtime safe; call it from prepareToPlay().
+     */
+    static size_t getDataCacheSize();
+
+    /** Returns the number of samples to process per chunk.
+     @param bytesPerSample  how much memory all the stages together touch per sample, counting
+                            the audio buffers and every delay line the reverb reads and writes
+     */
+    static int getChunkSize (const size_t bytesPerSample)
+    {
+        // Leave the other half of the cache for filter and reflection state, the stack and the code
+        const size_t budget = getDataCacheSize() / 2;
+        const int samples = (int) jmin ((size_t) maxChunkSize, budget / jmax ((size_t) 1, bytesPerSample));
+
+        return jlimit ((int) minChunkSize, (int) maxChunkSize, samples - samples % chunkAlignment);
+    }
+};
@@ -0,0 +1,304 @@
+/*
+  ==============================================================================
+
+    ControlEndpoint.h
+
+    Optional loopback UDP endpoint that lets show-control software set
+    parameters directly, without going through host automation. It is only
+    created when the TOKYO_REVERB_CONTROL_PORT environment variable is set.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** One timestamped parameter change on its way to the audio thread. */
+struct ControlEvent
+{
+    int parameterIndex;     /**< Index into the processor's parameter list. */
+    float value;            /**< New value in the parameter's own units, already clamped. */
+    int64 timestamp;        /**< Time::getHighResolutionTicks() when it arrived. */
+    uint32 sequence;        /**< Sender's sequence number, echoed back by "?" queries. */
+};
+
+//==============================================================================
+/**
+ Receives parameter changes on 127.0.0.1 and hands them to the audio thread through a
+ lock-free single-producer/single-consumer queue.
+
+ Each datagram holds one or more lines of text:
+ - "<parameterID> <value> [sequence]" sets a parameter, e.g. "room 0.8 17"
+ - "?" asks for the sequence number of the last change the audio thread has applied;
+   the reply "applied <sequence>" goes back to the sender
+
+ The reader thread stamps every change with its arrival time, drains whatever else is
+ already waiting on the socket, and coalesces the burst so that only the newest value
+ of each parameter is queued. It also hands the new values to the message thread so
+ that the host and the editor see them. That usually happens before the audio thread
+ gets to the change, so until it has been applied isInFlight() returns true and the
+ processor should ignore the host's copy of that parameter, which would otherwise
+ take effect from the start of the block instead of at the change's offset.
+
+ On the audio side, call popEvent() at the start of processBlock() and place each event
+ with getSampleOffset(), which keeps the spacing between events but delays them all by
+ one block.
+ */
+class ControlEndpoint  : private Thread,
+                         private AsyncUpdater
+{
+public:
+    //==============================================================================
+    enum { queueSize = 1024, maxDatagramSize = 2048, maxPortAttempts = 64 };
+
+    /** Returns an endpoint if TOKYO_REVERB_CONTROL_PORT is set, otherwise nullptr.
+     If the port is taken (e.g. by another instance) the next free one above it is used.
+     */
+    static std::unique_ptr<ControlEndpoint> createFromEnvironment (AudioProcessor& processor)
+    {
+        const int port = SystemStats::getEnvironmentVariable ("TOKYO_REVERB_CONTROL_PORT", {}).getIntValue();
+
+        if (port <= 0)
+            return {};
+
+        std::unique_ptr<ControlEndpoint> endpoint (new ControlEndpoint (processor));
+
+        for (int attempt = 0; attempt < maxPortAttempts; ++attempt)
+        {
+            if (endpoint->socket.bindToPort (port + attempt, "127.0.0.1"))
+            {
+                Logger::writeToLog ("TokyoRe:Verb control endpoint listening on 127.0.0.1:" + String (port + attempt));
+                endpoint->startThread (6);
+                return endpoint;
+            }
+        }
+
+        return {};
+    }
+
+    ~ControlEndpoint()
+    {
+        signalThreadShouldExit();
+        socket.shutdown();
+        stopThread (2000);
+        cancelPendingUpdate();
+    }
+
+    //==============================================================================
+    /** Audio thread: takes the next change off the queue, returns false when it's empty. */
+    bool popEvent (ControlEvent& event) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+            return false;
+
+        event = events[start1];
+        fifo.finishedRead (1);
+        return true;
+    }
+
+    /** Audio thread: where an event belongs in the block starting at blockStart. Events
+     that arrived during the previous block keep their position within it, so the whole
+     stream is delayed by exactly one block but without any jitter.
+     */
+    static int getSampleOffset (const ControlEvent& event, const int64 previousBlockStart,
+                                const double sampleRate, const int numSamples) noexcept
+    {
+        if (numSamples <= 0 || previousBlockStart == 0 || event.timestamp <= previousBlockStart)
+            return 0;
+
+        const double seconds = Time::highResolutionTicksToSeconds (event.timestamp - previousBlockStart);
+        return jlimit (0, numSamples - 1, (int) (seconds * sampleRate));
+    }
+
+    /** Audio thread: records the sequence number of an event once it has been applied. */
+    void markApplied (const ControlEvent& event) noexcept
+    {
+        --inFlight[event.parameterIndex];
+        lastApplied.store (event.sequence, std::memory_order_relaxed);
+    }
+
+    /** Audio thread: true while a change to this parameter is queued but not yet applied. */
+    bool isInFlight (const int parameterIndex) const noexcept
+    {
+        return inFlight[parameterIndex].load() > 0;
+    }
+
+private:
+    //==============================================================================
+    ControlEndpoint (AudioProcessor& processorToControl)
+        : Thread ("TokyoRe:Verb control"),
+          socket (false),
+          fifo (queueSize)
+    {
+        for (auto* p : processorToControl.getParameters())
+            if (auto* ranged = dynamic_cast<RangedAudioParameter*> (p))
+                parameters.add (ranged);
+
+        pending.resize ((size_t) parameters.size());
+        hostValues.reset (new std::atomic<float>[(size_t) parameters.size()]);
+        hostPending.reset (new std::atomic<bool>[(size_t) parameters.size()]);
+        inFlight.reset (new std::atomic<int>[(size_t) parameters.size()]);
+
+        for (int i = 0; i < parameters.size(); ++i)
+        {
+            hostPending[i] = false;
+            inFlight[i] = 0;
+        }
+    }
+
+    void run() override
+    {
+        HeapBlock<char> datagram ((size_t) maxDatagramSize + 1);
+
+        while (! threadShouldExit())
+        {
+            if (socket.waitUntilReady (true, 100) <= 0)
+                continue;
+
+            bool anyChanged = false;
+
+            // drain the whole burst before queueing anything, so it can be coalesced
+            while (socket.waitUntilReady (true, 0) > 0)
+            {
+                String senderAddress;
+                int senderPort = 0;
+                const int bytes = socket.read (datagram, maxDatagramSize, false, senderAddress, senderPort);
+
+                if (bytes <= 0)
+                    break;
+
+                datagram[bytes] = 0;
+                const int64 arrival = Time::getHighResolutionTicks();
+
+                for (auto& line : StringArray::fromLines (String::fromUTF8 (datagram, bytes)))
+                    anyChanged = handleLine (line.trim(), arrival, senderAddress, senderPort) || anyChanged;
+            }
+
+            if (anyChanged)
+                flushPending();
+        }
+    }
+
+    /** Returns true if the line changed a parameter. */
+    bool handleLine (const String& line, const int64 arrival, const String& senderAddress, const int senderPort)
+    {
+        if (line.isEmpty())
+            return false;
+
+        if (line == "?")
+        {
+            const String reply ("applied " + String ((int64) lastApplied.load (std::memory_order_relaxed)) + "\n");
+            socket.write (senderAddress, senderPort, reply.toRawUTF8(), (int) reply.getNumBytesAsUTF8());
+            return false;
+        }
+
+        const auto tokens = StringArray::fromTokens (line, false);
+
+        if (tokens.size() < 2)
+            return false;
+
+        for (int i = 0; i < parameters.size(); ++i)
+        {
+            if (parameters.getUnchecked (i)->paramID == tokens[0])
+            {
+                auto& p = pending[(size_t) i];
+                p.changed = true;
+                p.value = tokens[1].getFloatValue();
+                p.timestamp = arrival;
+                p.sequence = (uint32) tokens[2].getLargeIntValue();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /** Queues the newest value of every parameter changed in this burst, oldest first,
+     and forwards them to the message thread for the host and editor. */
+    void flushPending()
+    {
+        Array<ControlEvent> burst;
+
+        for (int i = 0; i < parameters.size(); ++i)
+        {
+            auto& p = pending[(size_t) i];
+
+            if (! p.changed)
+                continue;
+
+            auto* param = parameters.getUnchecked (i);
+            const float clamped = param->convertFrom0to1 (param->convertTo0to1 (p.value));
+
+            burst.add ({ i, clamped, p.timestamp, p.sequence });
+            p.changed = false;
+        }
+
+        std::sort (burst.begin(), burst.end(),
+                   [] (const ControlEvent& a, const ControlEvent& b) { return a.timestamp < b.timestamp; });
+
+        for (auto& e : burst)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+            if (size1 == 0)
+                break;      // the audio thread has stalled, drop rather than block
+
+            // counted before the host can see the value, and before the audio thread can pop it
+            ++inFlight[e.parameterIndex];
+            events[start1] = e;
+            fifo.finishedWrite (1);
+        }
+
+        for (auto& e : burst)
+        {
+            hostValues[e.parameterIndex].store (e.value);
+            hostPending[e.parameterIndex].store (true);
+        }
+
+        triggerAsyncUpdate();
+    }
+
+    /** Message thread: passes the newest values on to the host and any attached editor. */
+    void handleAsyncUpdate() override
+    {
+        for (int i = 0; i < parameters.size(); ++i)
+        {
+            if (hostPending[i].exchange (false))
+            {
+                auto* param = parameters.getUnchecked (i);
+                param->setValueNotifyingHost (param->convertTo0to1 (hostValues[i].load()));
+            }
+        }
+    }
+
+    //==============================================================================
+    struct PendingChange
+    {
+        bool changed = false;
+        float value = 0;
+        int64 timestamp = 0;
+        uint32 sequence = 0;
+    };
+
+    Array<RangedAudioParameter*> parameters;
+    std::vector<PendingChange> pending;
+
+    std::unique_ptr<std::atomic<float>[]> hostValues;
+    std::unique_ptr<std::atomic<bool>[]> hostPending;
+    std::unique_ptr<std::atomic<int>[]> inFlight;
+
+    DatagramSocket socket;
+
+    AbstractFifo fifo;
+    ControlEvent events[queueSize];
+
+    std::atomic<uint32> lastApplied { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ControlEndpoint)
+};
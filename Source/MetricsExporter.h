@@ -0,0 +1,267 @@
+/*
+  ==============================================================================
+
+    MetricsExporter.h
+
+    Optional background thread that publishes ProcessorMetrics outside the
+    process, for monitoring headless render nodes. It is only created when the
+    TOKYO_REVERB_METRICS_DIR environment variable is set.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ProcessorMetrics.h"
+#include "MetricsLayout.h"
+
+#include <cstdio>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#elif JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#endif
+
+//==============================================================================
+/**
+ Periodically copies an instance's ProcessorMetrics to a Prometheus text-format file
+ and, on Linux and macOS, to a shared-memory segment laid out as a
+ TokyoReverbMetrics::Block.
+
+ The exporter runs on its own thread and only ever reads the metrics through
+ ProcessorMetrics::getSnapshot(), so the audio thread never sees it. The .prom file is
+ written next to a temporary file and renamed over the old one in a single step, which
+ is what the node_exporter textfile collector expects.
+
+ This pulls in OS headers, so include it from PluginProcessor.cpp rather than from
+ other headers.
+
+ Environment variables:
+ - TOKYO_REVERB_METRICS_DIR          directory for the .prom files (enables the exporter)
+ - TOKYO_REVERB_METRICS_INTERVAL_MS  export interval, 1000 by default
+ */
+class MetricsExporter  : private Thread
+{
+public:
+    //==============================================================================
+    /** Returns an exporter if TOKYO_REVERB_METRICS_DIR is set, otherwise nullptr. */
+    static std::unique_ptr<MetricsExporter> createFromEnvironment (const ProcessorMetrics& metrics)
+    {
+        const String dir = SystemStats::getEnvironmentVariable ("TOKYO_REVERB_METRICS_DIR", {});
+
+        if (dir.isEmpty())
+            return {};
+
+        const int intervalMs = jmax (50, SystemStats::getEnvironmentVariable ("TOKYO_REVERB_METRICS_INTERVAL_MS", "1000")
+                                            .getIntValue());
+
+        return std::unique_ptr<MetricsExporter> (new MetricsExporter (metrics, File (dir), intervalMs));
+    }
+
+    MetricsExporter (const ProcessorMetrics& metricsToExport, const File& directory, const int intervalMilliseconds)
+        : Thread ("TokyoRe:Verb metrics"),
+          metrics (metricsToExport),
+          intervalMs (intervalMilliseconds),
+          processId (getProcessId()),
+          instanceIndex ((uint32) nextInstanceIndex()++)
+    {
+        directory.createDirectory();
+        const String baseName = "tokyoreverb_" + String (processId) + "_" + String (instanceIndex);
+        promFile = directory.getChildFile (baseName + ".prom");
+        tempFile = directory.getChildFile ("." + baseName + ".prom.tmp");
+
+        openSharedMemory();
+
+        previous = metrics.getSnapshot();
+        previousTicks = Time::getHighResolutionTicks();
+
+        startThread (1);
+    }
+
+    ~MetricsExporter()
+    {
+        stopThread (intervalMs + 1000);
+        promFile.deleteFile();
+        closeSharedMemory();
+    }
+
+private:
+    //==============================================================================
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            wait (intervalMs);
+
+            if (! threadShouldExit())
+                exportOnce();
+        }
+    }
+
+    void exportOnce()
+    {
+        const ProcessorMetrics::Snapshot current = metrics.getSnapshot();
+        const int64 nowTicks = Time::getHighResolutionTicks();
+
+        const double interval = Time::highResolutionTicksToSeconds (nowTicks - previousTicks);
+        const double cpuLoad  = ProcessorMetrics::Snapshot::cpuLoad (previous, current);
+        const double p99      = ProcessorMetrics::Snapshot::percentileSeconds (previous, current, 0.99);
+        const double maxBlock = Time::highResolutionTicksToSeconds ((int64) current.maxBlockTicks);
+        const double sleepRatio = current.blocks > previous.blocks ? 1.0 - jmin (1.0, cpuLoad) : 1.0;
+
+        writeSharedMemory (current, interval, cpuLoad, sleepRatio, p99, maxBlock);
+        writePrometheusFile (current, cpuLoad, sleepRatio, p99, maxBlock);
+
+        previous = current;
+        previousTicks = nowTicks;
+    }
+
+    //==============================================================================
+    void writePrometheusFile (const ProcessorMetrics::Snapshot& s, const double cpuLoad, const double sleepRatio,
+                              const double p99, const double maxBlock)
+    {
+        const String labels = "{pid=\"" + String (processId) + "\",plugin_instance=\"" + String (instanceIndex) + "\"}";
+        String text;
+
+        auto add = [&] (const char* name, const char* type, const char* help, const String& value)
+        {
+            text << "# HELP tokyoreverb_" << name << " " << help << "\n"
+                 << "# TYPE tokyoreverb_" << name << " " << type << "\n"
+                 << "tokyoreverb_" << name << labels << " " << value << "\n";
+        };
+
+        add ("cpu_load", "gauge", "Fraction of wall time spent in processBlock over the last interval.", String (cpuLoad, 6));
+        add ("sleep_ratio", "gauge", "Fraction of wall time spent outside processBlock over the last interval.", String (sleepRatio, 6));
+        add ("block_seconds_p99", "gauge", "99th percentile processBlock time over the last interval.", String (p99, 9));
+        add ("block_seconds_max", "gauge", "Slowest processBlock call since the instance was created.", String (maxBlock, 9));
+        add ("xrun_risk_total", "counter", "Blocks that used more than 70% of their real-time budget.", String ((int64) s.xrunRisks));
+        add ("blocks_total", "counter", "processBlock calls.", String ((int64) s.blocks));
+        add ("samples_total", "counter", "Samples processed.", String ((int64) s.samples));
+        add ("memory_bytes", "gauge", "Memory held by the instance's DSP state.", String ((int64) s.memoryBytes));
+
+        if (tempFile.replaceWithText (text))
+            replacePromFile();
+    }
+
+    /** Renames the temporary file over the .prom file. File::moveFileTo() deletes the target
+        before moving, which would let a scrape find no file at all, so this uses the OS's
+        own replacing rename instead.
+    */
+    bool replacePromFile() const
+    {
+       #if JUCE_WINDOWS
+        return MoveFileExW (tempFile.getFullPathName().toWideCharPointer(),
+                            promFile.getFullPathName().toWideCharPointer(), MOVEFILE_REPLACE_EXISTING) != 0;
+       #else
+        return std::rename (tempFile.getFullPathName().toRawUTF8(), promFile.getFullPathName().toRawUTF8()) == 0;
+       #endif
+    }
+
+    //==============================================================================
+    void writeSharedMemory (const ProcessorMetrics::Snapshot& s, const double interval, const double cpuLoad,
+                            const double sleepRatio, const double p99, const double maxBlock) noexcept
+    {
+        if (block == nullptr)
+            return;
+
+        const uint32 sequence = block->sequence.load (std::memory_order_relaxed);
+        block->sequence.store (sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+
+        block->updatedMillis   = Time::currentTimeMillis();
+        block->intervalSeconds = interval;
+        block->cpuLoad         = cpuLoad;
+        block->sleepRatio      = sleepRatio;
+        block->p99BlockSeconds = p99;
+        block->maxBlockSeconds = maxBlock;
+        block->blocks          = s.blocks;
+        block->samples         = s.samples;
+        block->xrunRisks       = s.xrunRisks;
+        block->memoryBytes     = s.memoryBytes;
+
+        block->sequence.store (sequence + 2, std::memory_order_release);
+    }
+
+    void openSharedMemory()
+    {
+       #if JUCE_LINUX || JUCE_MAC
+        TokyoReverbMetrics::makeSegmentName (segmentName, sizeof (segmentName), processId, instanceIndex);
+
+        const int fd = shm_open (segmentName, O_CREAT | O_RDWR, 0644);
+
+        if (fd < 0)
+            return;
+
+        if (ftruncate (fd, sizeof (TokyoReverbMetrics::Block)) == 0)
+        {
+            void* mapped = mmap (nullptr, sizeof (TokyoReverbMetrics::Block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (mapped != MAP_FAILED)
+            {
+                block = new (mapped) TokyoReverbMetrics::Block();
+                memcpy (block->magic, TokyoReverbMetrics::blockMagic, sizeof (block->magic));
+                block->version = TokyoReverbMetrics::layoutVersion;
+                block->processId = processId;
+                block->instanceIndex = instanceIndex;
+                block->sequence.store (0, std::memory_order_release);
+            }
+        }
+
+        close (fd);
+
+        if (block == nullptr)
+            shm_unlink (segmentName);
+       #endif
+    }
+
+    void closeSharedMemory()
+    {
+       #if JUCE_LINUX || JUCE_MAC
+        if (block != nullptr)
+        {
+            munmap (block, sizeof (TokyoReverbMetrics::Block));
+            shm_unlink (segmentName);
+            block = nullptr;
+        }
+       #endif
+    }
+
+    static uint32 getProcessId() noexcept
+    {
+       #if JUCE_LINUX || JUCE_MAC
+        return (uint32) getpid();
+       #elif JUCE_WINDOWS
+        return (uint32) GetCurrentProcessId();
+       #else
+        return 0;
+       #endif
+    }
+
+    static std::atomic<int>& nextInstanceIndex() noexcept
+    {
+        static std::atomic<int> index { 0 };
+        return index;
+    }
+
+    //==============================================================================
+    const ProcessorMetrics& metrics;
+    const int intervalMs;
+    const uint32 processId, instanceIndex;
+
+    File promFile, tempFile;
+    TokyoReverbMetrics::Block* block = nullptr;
+    char segmentName[64] = {};
+
+    ProcessorMetrics::Snapshot previous;
+    int64 previousTicks = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MetricsExporter)
+};
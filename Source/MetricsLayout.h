@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    MetricsLayout.h
+
+    The layout of the shared-memory block MetricsExporter publishes for each
+    plugin instance. This header is plain C++ with no JUCE dependency, so that
+    Tools/MetricsReader can include it as well.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+
+namespace TokyoReverbMetrics
+{
+    /** Bumped whenever the Block layout changes. */
+    static const uint32_t layoutVersion = 1;
+
+    /** Written at the start of every block so readers can reject foreign segments. */
+    static const char blockMagic[8] = { 'T', 'R', 'V', 'M', 'E', 'T', 'R', 'C' };
+
+    /** Prefix of every segment name, followed by "<pid>-<instance>". */
+    static const char* const segmentPrefix = "/tokyoreverb-";
+
+    //==============================================================================
+    /**
+     One instance's metrics.
+
+     The writer makes sequence odd before it starts updating the fields and even again
+     once it is done, so a reader that sees the same even value before and after copying
+     the block knows its copy is consistent.
+     */
+    struct Block
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t processId;
+        uint32_t instanceIndex;
+        std::atomic<uint32_t> sequence;
+
+        int64_t updatedMillis;      /**< Wall-clock time of the last update, ms since the epoch. */
+        double intervalSeconds;     /**< Length of the interval the rates below were measured over. */
+
+        double cpuLoad;             /**< Fraction of wall time spent in processBlock(). */
+        double sleepRatio;          /**< Fraction of wall time spent outside processBlock(). */
+        double p99BlockSeconds;     /**< 99th percentile block time over the interval. */
+        double maxBlockSeconds;     /**< Slowest block since the instance was created. */
+
+        uint64_t blocks;            /**< Total processBlock() calls. */
+        uint64_t samples;           /**< Total samples processed. */
+        uint64_t xrunRisks;         /**< Total blocks that used most of their real-time budget. */
+        uint64_t memoryBytes;       /**< Memory held by the instance's DSP state. */
+    };
+
+    static_assert (std::is_standard_layout<Block>::value, "Block is shared between processes");
+
+    /** Writes the shared-memory name for an instance into dest. */
+    inline void makeSegmentName (char* dest, const size_t destSize, const uint32_t processId, const uint32_t instanceIndex)
+    {
+        std::snprintf (dest, destSize, "%s%u-%u", segmentPrefix, processId, instanceIndex);
+    }
+}
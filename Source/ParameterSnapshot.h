@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    ParameterSnapshot.h
+
+    Keeps a flat, always-current copy of every parameter value so that
+    getStateInformation() can be answered by copying a few floats instead of
+    walking the ValueTree.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+ A flat snapshot of all the parameters of an AudioProcessorValueTreeState.
+
+ Every parameter gets a listener that stores its new value into an atomic slot as soon
+ as it changes, on whichever thread changed it. writeTo() then just copies those slots
+ into a small binary block, so hosts can capture state from any thread without taking
+ locks or touching the ValueTree.
+
+ The block starts with a magic tag and the number of values, followed by the values in
+ the order the parameters were added to the processor. New parameters must therefore
+ only ever be appended, and restoreFrom() leaves parameters missing from an older block
+ at their current value.
+ */
+class ParameterSnapshot
+{
+public:
+    //==============================================================================
+    ParameterSnapshot (AudioProcessorValueTreeState& stateToUse)
+        : state (stateToUse)
+    {
+        for (auto* p : state.processor.getParameters())
+            if (auto* withID = dynamic_cast<AudioProcessorParameterWithID*> (p))
+                parameterIDs.add (withID->paramID);
+
+        const int numValues = parameterIDs.size();
+        values.reset (new std::atomic<float>[(size_t) numValues]);
+
+        for (int i = 0; i < numValues; ++i)
+        {
+            values[i].store (*state.getRawParameterValue (parameterIDs[i]), std::memory_order_relaxed);
+            jassert (values[i].is_lock_free());
+
+            slots.add (new Slot (values[i]));
+            state.addParameterListener (parameterIDs[i], slots.getLast());
+        }
+    }
+
+    ~ParameterSnapshot()
+    {
+        for (int i = 0; i < parameterIDs.size(); ++i)
+            state.removeParameterListener (parameterIDs[i], slots[i]);
+    }
+
+    //==============================================================================
+    /** Replaces the contents of dest with the current snapshot. */
+    void writeTo (MemoryBlock& dest) const
+    {
+        const int numValues = parameterIDs.size();
+
+        Header header;
+        memcpy (header.magic, getMagicTag(), sizeof (header.magic));
+        header.numValues = (uint32) numValues;
+
+        dest.setSize (sizeof (Header) + (size_t) numValues * sizeof (float), false);
+
+        auto* data = static_cast<char*> (dest.getData());
+        memcpy (data, &header, sizeof (Header));
+
+        auto* out = reinterpret_cast<float*> (data + sizeof (Header));
+
+        for (int i = 0; i < numValues; ++i)
+            out[i] = values[i].load (std::memory_order_relaxed);
+    }
+
+    /** True if the data was written by writeTo(), as opposed to an older ValueTree state. */
+    static bool isSnapshot (const void* data, const int sizeInBytes) noexcept
+    {
+        return data != nullptr
+            && sizeInBytes >= (int) sizeof (Header)
+            && memcmp (data, getMagicTag(), sizeof (Header::magic)) == 0;
+    }
+
+    /** Pushes the values from a block written by writeTo() back into the parameters.
+     Returns false if the block isn't a snapshot, so the caller can fall back to the
+     old ValueTree format.
+     */
+    bool restoreFrom (const void* data, const int sizeInBytes)
+    {
+        if (! isSnapshot (data, sizeInBytes))
+            return false;
+
+        Header header;
+        memcpy (&header, data, sizeof (Header));
+
+        const auto* in = reinterpret_cast<const float*> (static_cast<const char*> (data) + sizeof (Header));
+        const int numStored = (int) jmin ((size_t) header.numValues,
+                                          ((size_t) sizeInBytes - sizeof (Header)) / sizeof (float));
+
+        for (int i = 0; i < jmin (numStored, parameterIDs.size()); ++i)
+        {
+            if (auto* param = state.getParameter (parameterIDs[i]))
+            {
+                float value;
+                memcpy (&value, in + i, sizeof (float));
+                param->setValueNotifyingHost (param->convertTo0to1 (value));
+            }
+        }
+
+        return true;
+    }
+
+private:
+    //==============================================================================
+    struct Header
+    {
+        char magic[4];
+        uint32 numValues;
+    };
+
+    static const char* getMagicTag() noexcept      { return "TRV1"; }
+
+    struct Slot  : public AudioProcessorValueTreeState::Listener
+    {
+        Slot (std::atomic<float>& target) : value (target) {}
+
+        void parameterChanged (const String&, float newValue) override
+        {
+            value.store (newValue, std::memory_order_relaxed);
+        }
+
+        std::atomic<float>& value;
+    };
+
+    AudioProcessorValueTreeState& state;
+    StringArray parameterIDs;
+    std::unique_ptr<std::atomic<float>[]> values;
+    OwnedArray<Slot> slots;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterSnapshot)
+};
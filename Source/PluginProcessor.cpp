@@ -11,6 +11,7 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 #include "Reverb_Edit.h"
+#include "MetricsExporter.h"
 
 //==============================================================================
 TokyoRe_verbAudioProcessor::TokyoRe_verbAudioProcessor()
@@ -19,6 +20,11 @@ TokyoRe_verbAudioProcessor::TokyoRe_verbAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  AudioChannelSet::stereo(), true)
+                       // Shared-room sends, one per entry in SharedRoom::numSends
+                       .withInput  ("Send 1", AudioChannelSet::stereo(), false)
+                       .withInput  ("Send 2", AudioChannelSet::stereo(), false)
+                       .withInput  ("Send 3", AudioChannelSet::stereo(), false)
+                       .withInput  ("Send 4", AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", AudioChannelSet::stereo(), true)
                      #endif
@@ -36,8 +42,18 @@ TokyoRe_verbAudioProcessor::TokyoRe_verbAudioProcessor()
          std::make_unique<AudioParameterFloat>("room", "Room", 0, 1, 0.5),
          std::make_unique<AudioParameterFloat>("damp", "Damp", 0, 1, 0.5),
          std::make_unique<AudioParameterFloat>("width", "Width", 0, 1, 0),
+         std::make_unique<AudioParameterFloat>("send1", "Send 1 Level", 0, 1, 1),
+         std::make_unique<AudioParameterFloat>("send2", "Send 2 Level", 0, 1, 1),
+         std::make_unique<AudioParameterFloat>("send3", "Send 3 Level", 0, 1, 1),
+         std::make_unique<AudioParameterFloat>("send4", "Send 4 Level", 0, 1, 1),
+         std::make_unique<AudioParameterFloat>("early1", "Send 1 Early", 0, 1, 0),
+         std::make_unique<AudioParameterFloat>("early2", "Send 2 Early", 0, 1, 0),
+         std::make_unique<AudioParameterFloat>("early3", "Send 3 Early", 0, 1, 0),
+         std::make_unique<AudioParameterFloat>("early4", "Send 4 Early", 0, 1, 0),
+         std::make_unique<AudioParameterFloat>("size", "Size", 0.5f, 2.0f, 1.0f),
          
-     }), lowPassFilter(dsp::IIR::Coefficients<float>::makeLowPass(44100, 20000.0f, 0.1f))
+     }), lowPassFilter(dsp::IIR::Coefficients<float>::makeLowPass(44100, 20000.0f, 0.1f)),
+         parameterSnapshot(mState)
 
 #endif
 {
@@ -50,21 +66,49 @@ TokyoRe_verbAudioProcessor::TokyoRe_verbAudioProcessor()
     tokyoReverbParameters.freezeMode = 0.0f;*/
     
     
+    // The DSP reads every parameter through liveValues, in getParameters() order (the same
+    // order the control endpoint uses), so that values sent over the endpoint can stand in
+    // for the host's until it catches up
+    for (auto* p : getParameters())
+        if (auto* ranged = dynamic_cast<RangedAudioParameter*> (p))
+            rawValues.add(mState.getRawParameterValue(ranged->paramID));
+    
+    liveValues.calloc((size_t) rawValues.size());
+    controlValues.calloc((size_t) rawValues.size());
+    controlBaseValues.calloc((size_t) rawValues.size());
+    controlActive.calloc((size_t) rawValues.size());
+    refreshLiveValues();
+    
+    auto liveValue = [this] (const String& paramID) { return liveValues + rawValues.indexOf(mState.getRawParameterValue(paramID)); };
+    
     //dry = mState.getRawParameterValue("dry");
     //wet = mState.getRawParameterValue("wet");
-    mix = mState.getRawParameterValue("mix");
-    room = mState.getRawParameterValue("room");
-    damp = mState.getRawParameterValue("damp");
-    width = mState.getRawParameterValue("width");
+    mix = liveValue("mix");
+    room = liveValue("room");
+    damp = liveValue("damp");
+    width = liveValue("width");
+    size = liveValue("size");
     
-    //updatedPara(0.4, 0.33, 05., 0.5, 0.5);
+    cutoffParameter = liveValue("cutoff");
+    resParameter = liveValue("resonance");
     
+    for (int i = 0; i < SharedRoom::numSends; ++i)
+    {
+        sendLevel[i] = liveValue("send" + String (i + 1));
+        sendEarly[i] = liveValue("early" + String (i + 1));
+    }
     
+    //updatedPara(0.4, 0.33, 05., 0.5, 0.5);
+    
+    metricsExporter = MetricsExporter::createFromEnvironment(metrics);
+    controlEndpoint = ControlEndpoint::createFromEnvironment(*this);
     
 }
 
 TokyoRe_verbAudioProcessor::~TokyoRe_verbAudioProcessor()
 {
+    controlEndpoint = nullptr;
+    metricsExporter = nullptr;
 }
 
 //==============================================================================
@@ -142,6 +186,14 @@ void TokyoRe_verbAudioProcessor::prepareToPlay (double sampleRate, int samplesPe
     tokyoReverb.setSampleRate(sampleRate);
     tokyoReverb.setParameters(tokyoReverbParameters);
     
+    // Big blocks are processed a chunk at a time, so that's all the scratch space ever needs.
+    // Per sample the stages touch the main bus, the shared-room feed and early reflections,
+    // and one slot in every delay line.
+    chunkSize = CacheBlocking::getChunkSize(sizeof(float) * (size_t) (getMainBusNumOutputChannels() + 2 * 2
+                                                                       + EditReverb::getNumDelayLines()));
+    
+    sharedRoom.prepare(sampleRate, chunkSize);
+    
     //lastSampleRate = sampleRate;
     
     // TAYLOR COMMENT:
@@ -151,11 +203,17 @@ void TokyoRe_verbAudioProcessor::prepareToPlay (double sampleRate, int samplesPe
     
     dsp::ProcessSpec spec;
     spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = getTotalNumInputChannels();
+    spec.maximumBlockSize = chunkSize;
+    spec.numChannels = getMainBusNumOutputChannels();
     
     lowPassFilter.prepare(spec);
     lowPassFilter.reset();
+    filterFreq = filterRes = -1.0f;
+    
+    previousBlockStart = 0;
+    
+    metrics.resetTiming();
+    metrics.setMemoryBytes(sizeof(*this) + tokyoReverb.getMemoryUsage() + sharedRoom.getMemoryUsage());
     
     //tokyoReverb.prepare(spec);
    // tokyoReverb.reset();
@@ -188,6 +246,15 @@ bool TokyoRe_verbAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+    
+    // The shared-room sends can each be switched off, mono or stereo
+    for (int i = 1; i < layouts.inputBuses.size(); ++i)
+    {
+        const auto& send = layouts.inputBuses.getReference (i);
+        
+        if (! send.isDisabled() && send != AudioChannelSet::mono() && send != AudioChannelSet::stereo())
+            return false;
+    }
    #endif
 
     return true;
@@ -202,12 +269,52 @@ bool TokyoRe_verbAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
 
 void TokyoRe_verbAudioProcessor::updateFilter()
 {
-    float freq = *mState.getRawParameterValue("cutoff");
-    float res = *mState.getRawParameterValue("resonance");
+    float freq = *cutoffParameter;
+    float res = *resParameter;
+    
+    // This runs for every segment of every block, so only rebuild the coefficients when needed
+    if (freq == filterFreq && res == filterRes)
+        return;
+    
+    filterFreq = freq;
+    filterRes = res;
     
     *lowPassFilter.state = *dsp::IIR::Coefficients<float>::makeLowPass(currentSampleRate, freq, res);
 }
 
+void TokyoRe_verbAudioProcessor::refreshLiveValues() noexcept
+{
+    for (int i = 0; i < rawValues.size(); ++i)
+    {
+        // The host usually gets a control change (via the message thread) before we apply it
+        // at its offset, so its copy must wait until then
+        if (controlEndpoint != nullptr && controlEndpoint->isInFlight(i))
+            continue;
+        
+        const float raw = *rawValues.getUnchecked(i);
+        
+        // Once the host's value moves (usually to the one we sent) it takes over again
+        if (controlActive[i] && raw != controlBaseValues[i])
+            controlActive[i] = false;
+        
+        liveValues[i] = controlActive[i] ? controlValues[i] : raw;
+    }
+}
+
+void TokyoRe_verbAudioProcessor::applyControlEvent (const ControlEvent& event) noexcept
+{
+    const int i = event.parameterIndex;
+    
+    if (! isPositiveAndBelow(i, rawValues.size()))
+        return;
+    
+    liveValues[i] = controlValues[i] = event.value;
+    controlBaseValues[i] = *rawValues.getUnchecked(i);
+    controlActive[i] = true;
+    
+    controlEndpoint->markApplied(event);
+}
+
 /*void TokyoRe_verbAudioProcessor::updateReverb()
 {
     
@@ -232,6 +339,7 @@ void TokyoRe_verbAudioProcessor::updateFilter()
 void TokyoRe_verbAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
 {
     ScopedNoDenormals noDenormals;
+    const auto blockStart = metrics.beginBlock();
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     
@@ -246,19 +354,34 @@ void TokyoRe_verbAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiB
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    tokyoReverbParameters.roomSize = *room;
-    tokyoReverbParameters.width = *width;
-    tokyoReverbParameters.damping = *damp;
-    tokyoReverbParameters.dryLevel = 1 - *mix;
-    tokyoReverbParameters.wetLevel = *mix;
+    // Control endpoint changes that arrived during the last block are applied at the same
+    // position within this one, splitting the block wherever one lands
+    const int numSamples = buffer.getNumSamples();
+    int position = 0;
     
-    tokyoReverb.setParameters(tokyoReverbParameters);
+    refreshLiveValues();
     
-    if (totalNumInputChannels == 1)
-        tokyoReverb.processMono(buffer.getWritePointer(0), buffer.getNumSamples());
+    if (controlEndpoint != nullptr)
+    {
+        ControlEvent event;
+        
+        while (controlEndpoint->popEvent(event))
+        {
+            const int offset = jmax(position, ControlEndpoint::getSampleOffset(event, previousBlockStart,
+                                                                               currentSampleRate, numSamples));
+            
+            if (offset > position)
+            {
+                processSegment(buffer, position, offset - position);
+                position = offset;
+            }
+            
+            applyControlEvent(event);
+        }
+    }
     
-    else
-        tokyoReverb.processStereo(buffer.getWritePointer(0), buffer.getWritePointer(1), buffer.getNumSamples());
+    if (position < numSamples)
+        processSegment(buffer, position, numSamples - position);
     
     // TAYLOR COMMENT:
     // HERE IN THE PROCESS BLOCK IS WHERE EVERYTHING HAPPENS
@@ -325,14 +448,96 @@ void TokyoRe_verbAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiB
         
     }
     
-    dsp::AudioBlock<float> block (buffer);
+    previousBlockStart = blockStart;
+    
+    //tokyoReverb.reset();
+    
+    metrics.endBlock(blockStart, numSamples, currentSampleRate);
+    
+}
+
+void TokyoRe_verbAudioProcessor::processSegment (AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    tokyoReverbParameters.roomSize = *room;
+    tokyoReverbParameters.width = *width;
+    tokyoReverbParameters.damping = *damp;
+    tokyoReverbParameters.dryLevel = 1 - *mix;
+    tokyoReverbParameters.wetLevel = *mix;
+    tokyoReverbParameters.size = *size;
+    
+    tokyoReverb.setParameters(tokyoReverbParameters);
+    
+    // Each chunk goes through every stage before the next one starts, so large offline blocks
+    // never fall out of the cache between the reverb and the filter. Chunks are evened out
+    // so a block just over chunkSize doesn't leave a tiny one at the end.
+    const int numChunks = (numSamples + chunkSize - 1) / chunkSize;
+    const int samplesPerChunk = jmin(chunkSize, ((numSamples + numChunks - 1) / numChunks + CacheBlocking::chunkAlignment - 1)
+                                                 & ~(CacheBlocking::chunkAlignment - 1));
+    
+    for (int offset = 0; offset < numSamples; offset += samplesPerChunk)
+        processChunk(buffer, startSample + offset, jmin(samplesPerChunk, numSamples - offset));
+}
+
+void TokyoRe_verbAudioProcessor::processChunk (AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    // The main bus carries the dry signal and the wet return, any enabled send buses
+    // only feed the shared comb/allpass tail
+    auto mainBus = getBusBuffer(buffer, true, 0);
+    AudioBuffer<float> mainBuffer (mainBus.getArrayOfWritePointers(), mainBus.getNumChannels(), startSample, numSamples);
+    const int numNetworkChannels = jmin(mainBuffer.getNumChannels(), 2);
+    bool anySendActive = false;
+    
+    for (int i = 0; i < SharedRoom::numSends; ++i)
+    {
+        auto* send = getBus(true, i + 1);
+        
+        if (send == nullptr || ! send->isEnabled())
+        {
+            sharedRoom.disableSend(i);
+            continue;
+        }
+        
+        if (! anySendActive)
+        {
+            sharedRoom.beginBlock(mainBuffer, numNetworkChannels, numSamples);
+            anySendActive = true;
+        }
+        
+        auto sendBus = getBusBuffer(buffer, true, i + 1);
+        AudioBuffer<float> sendBuffer (sendBus.getArrayOfWritePointers(), sendBus.getNumChannels(), startSample, numSamples);
+        
+        sharedRoom.addSend(i, sendBuffer, numSamples, *sendLevel[i], *sendEarly[i]);
+    }
+    
+    if (! anySendActive)
+    {
+        if (numNetworkChannels == 1)
+            tokyoReverb.processMono(mainBuffer.getWritePointer(0), numSamples);
+        
+        else
+            tokyoReverb.processStereo(mainBuffer.getWritePointer(0), mainBuffer.getWritePointer(1), numSamples);
+    }
+    else
+    {
+        if (numNetworkChannels == 1)
+            tokyoReverb.processMono(mainBuffer.getWritePointer(0), sharedRoom.getFeed(0), numSamples);
+        
+        else
+            tokyoReverb.processStereo(mainBuffer.getWritePointer(0), mainBuffer.getWritePointer(1),
+                                      sharedRoom.getFeed(0), sharedRoom.getFeed(1), numSamples);
+        
+        if (sharedRoom.hasEarlyReflections())
+            for (int ch = 0; ch < numNetworkChannels; ++ch)
+                FloatVectorOperations::addWithMultiply(mainBuffer.getWritePointer(ch), sharedRoom.getEarly(ch),
+                                                       tokyoReverb.getWetGain(), numSamples);
+    }
+    
+    dsp::AudioBlock<float> block (mainBuffer);
     //updateReverb();
     //tokyoReverb.process(dsp::ProcessContextReplacing<float> (block));
     updateFilter();
     lowPassFilter.process(dsp::ProcessContextReplacing <float> (block));
     
-    //tokyoReverb.reset();
-    
 }
 
 //==============================================================================
@@ -356,8 +561,10 @@ void TokyoRe_verbAudioProcessor::getStateInformation (MemoryBlock& destData)
     // TAYLOR COMMENT:
     // THIS AND THE NEXT SECTION IS SETTING THE PLUGIN UP TO REMEMBER PARAMETERS AND SAVE STATES
     // YOU CAN BASICALLY COPY THIS WHOLE getStateInformation AND setStateInformation SECTION DIRECT TO YOURS
-    MemoryOutputStream stream(destData, false);
-    mState.state.writeToStream(stream);
+    
+    // Hosts call this from any thread during autosave, so rather than serialising mState.state
+    // this just copies the flat parameter snapshot - no tree traversal and no locks
+    parameterSnapshot.writeTo(destData);
     
 }
 
@@ -368,6 +575,10 @@ void TokyoRe_verbAudioProcessor::setStateInformation (const void* data, int size
     
     // TAYLOR COMMENT:
     // LIKE I SAID ABOVE, YOU CAN STRAIGHT UP COPY THIS SECTION TO YOURS
+    if (parameterSnapshot.restoreFrom(data, sizeInBytes))
+        return;
+    
+    // Sessions saved before the flat snapshot format still hold the whole ValueTree
     ValueTree tree = ValueTree::readFromData(data, sizeInBytes);
     if (tree.isValid()) {
         mState.state = tree;
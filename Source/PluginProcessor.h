@@ -12,6 +12,13 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "Reverb_Edit.h"
+#include "SharedRoom.h"
+#include "ParameterSnapshot.h"
+#include "ProcessorMetrics.h"
+#include "ControlEndpoint.h"
+#include "CacheBlocking.h"
+
+class MetricsExporter;
 
 //==============================================================================
 /**
@@ -78,6 +85,17 @@ public:
 
 private:
     
+    // Renders one stretch of the block with whatever parameter values are live at that point,
+    // in chunks of at most chunkSize samples
+    void processSegment (AudioBuffer<float>& buffer, int startSample, int numSamples);
+    
+    // Runs every stage (sends, reverb, early reflections, filter) over one cache-sized chunk
+    void processChunk (AudioBuffer<float>& buffer, int startSample, int numSamples);
+    
+    // Picks up the latest host/editor values, unless the control endpoint has overridden them
+    void refreshLiveValues() noexcept;
+    void applyControlEvent (const ControlEvent& event) noexcept;
+    
     float currentSampleRate;
     //float lastSampleRate;
     
@@ -106,12 +124,22 @@ private:
     float *width = 0;
     float *mix = 0;
     
+    // Scales every comb and allpass length (0.5 to 2), where room only sets their feedback
+    float *size = 0;
+    
+    // Send level and early-reflection amount for each of the shared-room send buses
+    float *sendLevel[SharedRoom::numSends] = {};
+    float *sendEarly[SharedRoom::numSends] = {};
+    
     
     //Reverb tokyoReverb;
     //Reverb::Parameters tokyoReverbParameters;
     EditReverb tokyoReverb;
     EditReverb::Parameters tokyoReverbParameters;
     
+    // Sums the main input and the send buses into the one network above
+    SharedRoom sharedRoom;
+    
     //juce::dsp::ProcessorChain<juce::dsp::Reverb> tokyoReverb;
     
     enum
@@ -128,6 +156,32 @@ private:
     
     // THIS IS SETTING UP THE LOWPASS FILTER, WILL NEED TO CHANGE FOR WHAT FILTER YOU DO (PROBS JUST CHANGING THE IIR PART TO WHATEVER KIND OF FILTER YOU DO)
     dsp::ProcessorDuplicator<dsp::IIR::Filter <float>, dsp::IIR::Coefficients<float>> lowPassFilter;
+    
+    // Flat copy of every parameter value, kept up to date by the parameter listeners so that
+    // getStateInformation() never has to walk mState.state
+    ParameterSnapshot parameterSnapshot;
+    
+    // Lock-free block timing counters, and the optional exporter that publishes them
+    // (only created when TOKYO_REVERB_METRICS_DIR is set)
+    ProcessorMetrics metrics;
+    std::unique_ptr<MetricsExporter> metricsExporter;
+    
+    // Optional loopback control endpoint (only created when TOKYO_REVERB_CONTROL_PORT is set).
+    // The DSP reads liveValues rather than the raw parameters, so a value sent over the
+    // endpoint holds until the host's copy of that parameter next changes.
+    std::unique_ptr<ControlEndpoint> controlEndpoint;
+    Array<float*> rawValues;
+    HeapBlock<float> liveValues, controlValues, controlBaseValues;
+    HeapBlock<bool> controlActive;
+    int64 previousBlockStart = 0;
+    
+    // The filter coefficients only get rebuilt when these change
+    float filterFreq = -1.0f;
+    float filterRes = -1.0f;
+    
+    // The most samples pushed through all the stages at once, sized from the CPU's cache in
+    // prepareToPlay(). All the scratch buffers are allocated for exactly this many.
+    int chunkSize = CacheBlocking::minChunkSize;
     //dsp::ProcessorChain<juce::dsp::Reverb> tokyoReverb;
     
     //==============================================================================
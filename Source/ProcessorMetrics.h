@@ -0,0 +1,170 @@
+/*
+  ==============================================================================
+
+    ProcessorMetrics.h
+
+    Lock-free counters describing how expensive processBlock() is. The audio
+    thread only ever does relaxed atomic adds and stores here; anything that
+    wants to look at the numbers takes a Snapshot from another thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+ Per-instance performance counters, written by the audio thread.
+
+ Wrap processBlock() in beginBlock()/endBlock(). Block times are binned into a
+ histogram with eight bins per octave of microseconds, which is enough to get a p99
+ over any interval by diffing two snapshots.
+ */
+class ProcessorMetrics
+{
+public:
+    //==============================================================================
+    enum
+    {
+        binsPerOctave = 8,
+        numBins = 17 * binsPerOctave    // 1us up to ~131ms, the last bin catches anything slower
+    };
+
+    /** A block that takes more than this fraction of its real-time budget counts as an xrun risk. */
+    static constexpr double xrunRiskThreshold = 0.7;
+
+    ProcessorMetrics()
+    {
+        for (auto& b : histogram)
+            b.store (0, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    /** Call at the very top of processBlock(). Returns the start time to pass to endBlock(). */
+    int64 beginBlock() noexcept
+    {
+        const int64 now = Time::getHighResolutionTicks();
+        const int64 previous = lastBlockStart.exchange (now, std::memory_order_relaxed);
+
+        if (previous != 0)
+            wallTicks.fetch_add ((uint64) (now - previous), std::memory_order_relaxed);
+
+        return now;
+    }
+
+    /** Call at the very end of processBlock(). */
+    void endBlock (const int64 blockStart, const int numSamples, const double sampleRate) noexcept
+    {
+        const int64 elapsed = Time::getHighResolutionTicks() - blockStart;
+        const double seconds = Time::highResolutionTicksToSeconds (elapsed);
+
+        busyTicks.fetch_add ((uint64) elapsed, std::memory_order_relaxed);
+        blocks.fetch_add (1, std::memory_order_relaxed);
+        samples.fetch_add ((uint64) numSamples, std::memory_order_relaxed);
+        histogram[binForSeconds (seconds)].fetch_add (1, std::memory_order_relaxed);
+
+        if (sampleRate > 0 && numSamples > 0 && seconds > xrunRiskThreshold * numSamples / sampleRate)
+            xrunRisks.fetch_add (1, std::memory_order_relaxed);
+
+        uint64 slowest = maxBlockTicks.load (std::memory_order_relaxed);
+
+        while ((uint64) elapsed > slowest
+                && ! maxBlockTicks.compare_exchange_weak (slowest, (uint64) elapsed, std::memory_order_relaxed))
+        {}
+    }
+
+    /** Forgets the previous callback time, call from prepareToPlay() so that the gap while
+     the host had stopped processing doesn't count as idle time. */
+    void resetTiming() noexcept
+    {
+        lastBlockStart.store (0, std::memory_order_relaxed);
+    }
+
+    /** Records how much memory the instance holds, set whenever buffers are (re)allocated. */
+    void setMemoryBytes (const size_t bytes) noexcept
+    {
+        memoryBytes.store ((uint64) bytes, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    /** A copy of all counters, taken from a non-audio thread. */
+    struct Snapshot
+    {
+        uint64 blocks = 0, samples = 0, busyTicks = 0, wallTicks = 0;
+        uint64 maxBlockTicks = 0, xrunRisks = 0, memoryBytes = 0;
+        uint64 histogram[numBins] = {};
+
+        /** Fraction of wall-clock time spent inside processBlock() between two snapshots. */
+        static double cpuLoad (const Snapshot& from, const Snapshot& to) noexcept
+        {
+            const uint64 wall = to.wallTicks - from.wallTicks;
+            return wall > 0 ? (double) (to.busyTicks - from.busyTicks) / (double) wall : 0.0;
+        }
+
+        /** Block time in seconds below which the given fraction of blocks between two snapshots finished. */
+        static double percentileSeconds (const Snapshot& from, const Snapshot& to, const double fraction) noexcept
+        {
+            const uint64 total = to.blocks - from.blocks;
+
+            if (total == 0)
+                return 0.0;
+
+            const uint64 target = (uint64) std::ceil (fraction * (double) total);
+            uint64 count = 0;
+
+            for (int i = 0; i < numBins; ++i)
+            {
+                count += to.histogram[i] - from.histogram[i];
+
+                if (count >= target)
+                    return upperEdgeSeconds (i);
+            }
+
+            return upperEdgeSeconds (numBins - 1);
+        }
+    };
+
+    Snapshot getSnapshot() const noexcept
+    {
+        Snapshot s;
+        s.blocks        = blocks.load (std::memory_order_relaxed);
+        s.samples       = samples.load (std::memory_order_relaxed);
+        s.busyTicks     = busyTicks.load (std::memory_order_relaxed);
+        s.wallTicks     = wallTicks.load (std::memory_order_relaxed);
+        s.maxBlockTicks = maxBlockTicks.load (std::memory_order_relaxed);
+        s.xrunRisks     = xrunRisks.load (std::memory_order_relaxed);
+        s.memoryBytes   = memoryBytes.load (std::memory_order_relaxed);
+
+        for (int i = 0; i < numBins; ++i)
+            s.histogram[i] = histogram[i].load (std::memory_order_relaxed);
+
+        return s;
+    }
+
+    /** The upper edge of a histogram bin, in seconds. */
+    static double upperEdgeSeconds (const int bin) noexcept
+    {
+        return std::pow (2.0, (bin + 1) / (double) binsPerOctave) * 1.0e-6;
+    }
+
+private:
+    //==============================================================================
+    static int binForSeconds (const double seconds) noexcept
+    {
+        const double micros = seconds * 1.0e6;
+
+        if (micros <= 1.0)
+            return 0;
+
+        return jmin ((int) numBins - 1, (int) (std::log2 (micros) * binsPerOctave));
+    }
+
+    std::atomic<uint64> blocks { 0 }, samples { 0 }, busyTicks { 0 }, wallTicks { 0 };
+    std::atomic<uint64> maxBlockTicks { 0 }, xrunRisks { 0 }, memoryBytes { 0 };
+    std::atomic<int64> lastBlockStart { 0 };
+    std::atomic<uint64> histogram[numBins];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProcessorMetrics)
+};
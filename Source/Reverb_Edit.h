@@ -57,7 +57,8 @@ public:
         wetLevel   (0.33f),
         dryLevel   (0.4f),
         width      (1.0f),
-        freezeMode (0)
+        freezeMode (0),
+        size       (1.0f)
         {}
         
         float roomSize;     /**< Room size, 0 to 1.0, where 1.0 is big, 0 is small. */
@@ -67,6 +68,8 @@ public:
         float width;        /**< Reverb width, 0 to 1.0, where 1.0 is very wide. */
         float freezeMode;   /**< Freeze mode - values < 0.5 are "normal" mode, values > 0.5
                              put the reverb into a continuous feedback loop. */
+        float size;         /**< Physical room size, 0.5 to 2.0 - scales every comb and allpass
+                             length, where 1.0 is the original FreeVerb tuning. */
     };
     
     //==============================================================================
@@ -87,6 +90,10 @@ public:
         wet2 = wet * (1.0f - newParams.width) * 0.5f;
         dry = newParams.dryLevel * dryScaleFactor;
         gain = isFrozen (newParams.freezeMode) ? 0.0f : 0.015f;
+        
+        if (newParams.size != parameters.size)
+            shouldUpdateSize = true;
+        
         parameters = newParams;
         shouldUpdateDamping = true;
     }
@@ -94,6 +101,8 @@ public:
     //==============================================================================
     /** Sets the sample rate that will be used for the reverb.
      You must call this before the process methods, in order to tell it the correct sample rate.
+     This is the only place the delay lines are allocated: each one is made long enough for
+     the largest size, so changing the size later never reallocates.
      */
     void setSampleRate (const double sampleRate)
     {
@@ -103,20 +112,22 @@ public:
         static const short allPassTunings[] = { 556, 441, 341, 225 };
         const int stereoSpread = 23;
         const int intSampleRate = (int) sampleRate;
+        const float scale = getSizeScale();
         
         for (int i = 0; i < numCombs; ++i)
         {
-            comb[0][i].setSize ((intSampleRate * combTunings[i]) / 44100);
-            comb[1][i].setSize ((intSampleRate * (combTunings[i] + stereoSpread)) / 44100);
+            comb[0][i].setSize ((intSampleRate * combTunings[i]) / 44100, scale);
+            comb[1][i].setSize ((intSampleRate * (combTunings[i] + stereoSpread)) / 44100, scale);
         }
         
         for (int i = 0; i < numAllPasses; ++i)
         {
-            allPass[0][i].setSize ((intSampleRate * allPassTunings[i]) / 44100);
-            allPass[1][i].setSize ((intSampleRate * (allPassTunings[i] + stereoSpread)) / 44100);
+            allPass[0][i].setSize ((intSampleRate * allPassTunings[i]) / 44100, scale);
+            allPass[1][i].setSize ((intSampleRate * (allPassTunings[i] + stereoSpread)) / 44100, scale);
         }
         
         shouldUpdateDamping = true;
+        shouldUpdateSize = false;
     }
     
     /** Clears the reverb's buffers. */
@@ -135,15 +146,32 @@ public:
     //==============================================================================
     /** Applies the reverb to two stereo channels of audio data. */
     void processStereo (float* const left, float* const right, const int numSamples) noexcept
+    {
+        processStereo (left, right, left, right, numSamples);
+    }
+    
+    /** Applies the reverb to two stereo channels of audio data, feeding the comb/allpass
+     network from a separate pair of channels.
+     The dry signal is taken from left/right, while feedLeft/feedRight are what enters the
+     tail, so several sources can be summed into one shared room. The feed pointers may
+     alias left/right.
+     */
+    void processStereo (float* const left, float* const right,
+                        const float* const feedLeft, const float* const feedRight,
+                        const int numSamples) noexcept
     {
         jassert (left != nullptr && right != nullptr);
+        jassert (feedLeft != nullptr && feedRight != nullptr);
         
         if (shouldUpdateDamping)
             updateDamping();
         
+        if (shouldUpdateSize)
+            updateSize();
+        
         for (int i = 0; i < numSamples; ++i)
         {
-            const float input = (left[i] + right[i]) * gain;
+            const float input = (feedLeft[i] + feedRight[i]) * gain;
             float outL = 0, outR = 0;
             
             for (int j = 0; j < numCombs; ++j)  // accumulate the comb filters in parallel
@@ -166,14 +194,25 @@ public:
     /** Applies the reverb to a single mono channel of audio data. */
     void processMono (float* const samples, const int numSamples) noexcept
     {
-        jassert (samples != nullptr);
+        processMono (samples, samples, numSamples);
+    }
+    
+    /** Applies the reverb to a single mono channel of audio data, feeding the network from
+     a separate channel. The feed pointer may alias samples.
+     */
+    void processMono (float* const samples, const float* const feed, const int numSamples) noexcept
+    {
+        jassert (samples != nullptr && feed != nullptr);
         
         if (shouldUpdateDamping)
             updateDamping();
         
+        if (shouldUpdateSize)
+            updateSize();
+        
         for (int i = 0; i < numSamples; ++i)
         {
-            const float input = samples[i] * gain;
+            const float input = feed[i] * gain;
             float output = 0;
             
             for (int j = 0; j < numCombs; ++j)  // accumulate the comb filters in parallel
@@ -182,15 +221,42 @@ public:
             for (int j = 0; j < numAllPasses; ++j)  // run the allpass filters in series
                 output = allPass[0][j].process (output);
             
-            samples[i] = output * wet1 + input * dry;
+            samples[i] = output * wet1 + (samples[i] * gain) * dry;
         }
     }
     
+    /** Returns the number of bytes held by the comb and allpass delay lines (allocated for
+     the largest size, whatever the current one is). */
+    size_t getMemoryUsage() const noexcept
+    {
+        size_t numFloats = 0;
+        
+        for (int j = 0; j < numChannels; ++j)
+        {
+            for (int i = 0; i < numCombs; ++i)
+                numFloats += (size_t) comb[j][i].getSize();
+            
+            for (int i = 0; i < numAllPasses; ++i)
+                numFloats += (size_t) allPass[j][i].getSize();
+        }
+        
+        return numFloats * sizeof (float);
+    }
+    
+    /** Returns how many delay lines each stereo sample passes through, i.e. how many
+     buffer positions are read and written per sample of input. */
+    static int getNumDelayLines() noexcept              { return numChannels * (numCombs + numAllPasses); }
+    
+    /** Returns the scaled wet gain applied to the network output, so that extra wet
+     components (e.g. early reflections) can be mixed in at the same level as the tail. */
+    float getWetGain() const noexcept                   { return wet1; }
+    
 private:
     //==============================================================================
     Parameters parameters;
     
     volatile bool shouldUpdateDamping;
+    volatile bool shouldUpdateSize = false;
     float gain, wet1, wet2, dry;
     
     inline static bool isFrozen (const float freezeMode) noexcept  { return freezeMode >= 0.5f; }
@@ -217,30 +283,173 @@ private:
                 comb[j][i].setFeedbackAndDamp (roomSizeToUse, dampingToUse);
     }
     
+    float getSizeScale() const noexcept     { return jlimit (0.5f, (float) maxSizeScale, parameters.size); }
+    
+    /** Sends every read head gliding towards the lengths for the current size. Realtime safe. */
+    void updateSize() noexcept
+    {
+        shouldUpdateSize = false;
+        
+        const float scale = getSizeScale();
+        
+        for (int j = 0; j < numChannels; ++j)
+        {
+            for (int i = 0; i < numCombs; ++i)
+                comb[j][i].setScale (scale);
+            
+            for (int i = 0; i < numAllPasses; ++i)
+                allPass[j][i].setScale (scale);
+        }
+    }
+    
     //==============================================================================
-    class CombFilter
+    /** A circular buffer with room for the longest delay a filter can be stretched to.
+     When the length changes the read head glides to its new position, reading between
+     samples on the way, so that a size sweep bends the pitch of the tail slightly rather
+     than clicking. Once it arrives, reads are whole-sample again and cost the same as a
+     fixed-length line.
+     */
+    class GlidingDelay
     {
     public:
-        CombFilter() noexcept  : bufferSize (0), bufferIndex (0) {}
+        GlidingDelay() noexcept  : bufferSize (0), writeIndex (0), readIndex (0), targetLength (1),
+                                   length (1.0f), gliding (false) {}
         
-        void setSize (const int size)
+        /** Allocates room for up to maxLength samples of delay and clears it. */
+        void allocate (const int maxLength)
         {
+            const int size = maxLength + 1;     // the extra slot is the interpolation neighbour
+            
             if (size != bufferSize)
             {
-                bufferIndex = 0;
                 buffer.malloc ((size_t) size);
                 bufferSize = size;
             }
             
+            writeIndex = 0;
             clear();
         }
         
+        int getAllocatedSize() const noexcept   { return bufferSize; }
+        
         void clear() noexcept
         {
-            last = 0;
             buffer.clear ((size_t) bufferSize);
         }
         
+        /** Moves the read head straight to a new length, for use before processing starts. */
+        void setLength (const int newLength) noexcept
+        {
+            targetLength = jlimit (1, bufferSize - 1, newLength);
+            length = (float) targetLength;
+            gliding = false;
+            updateReadIndex();
+        }
+        
+        /** Lets the read head glide to a new length over the following samples. */
+        void glideTo (const int newLength) noexcept
+        {
+            targetLength = jlimit (1, bufferSize - 1, newLength);
+            gliding = length != (float) targetLength;
+            
+            if (! gliding)
+                updateReadIndex();
+        }
+        
+        /** Returns the sample written the current length ago. Call once per sample, before write(). */
+        inline float read() noexcept
+        {
+            return gliding ? readGliding() : buffer [readIndex];
+        }
+        
+        inline void write (const float value) noexcept
+        {
+            buffer [writeIndex] = value;
+            
+            if (++writeIndex >= bufferSize)
+                writeIndex = 0;
+            
+            if (++readIndex >= bufferSize)
+                readIndex = 0;
+        }
+        
+    private:
+        // Kept out of line so that inlining read() into every comb and allpass only adds a
+        // flag test and a call, rather than a copy of the rarely used interpolation code
+       #if JUCE_MSVC
+        __declspec (noinline)
+       #else
+        __attribute__ ((noinline))
+       #endif
+        float readGliding() noexcept
+        {
+            // At most 1/16 of a sample per sample, i.e. about a semitone of bend while moving
+            const float maxGlide = 1.0f / 16.0f;
+            const float target = (float) targetLength;
+            length = length < target ? jmin (length + maxGlide, target) : jmax (length - maxGlide, target);
+            
+            const int whole = (int) length;
+            const float fraction = length - (float) whole;
+            
+            int index = writeIndex - whole;
+            
+            if (index < 0)
+                index += bufferSize;
+            
+            if (length == target)
+            {
+                gliding = false;
+                readIndex = index;
+                return buffer [index];
+            }
+            
+            const int older = index > 0 ? index - 1 : bufferSize - 1;
+            
+            return buffer [index] + fraction * (buffer [older] - buffer [index]);
+        }
+        
+        void updateReadIndex() noexcept
+        {
+            readIndex = writeIndex - targetLength;
+            
+            if (readIndex < 0)
+                readIndex += bufferSize;
+        }
+        
+        HeapBlock<float> buffer;
+        int bufferSize, writeIndex, readIndex, targetLength;
+        float length;
+        bool gliding;
+        
+        JUCE_DECLARE_NON_COPYABLE (GlidingDelay)
+    };
+    
+    //==============================================================================
+    class CombFilter
+    {
+    public:
+        CombFilter() noexcept  : nominalSize (0) {}
+        
+        /** Allocates for the largest size and starts at the given scale. Not realtime safe. */
+        void setSize (const int size, const float scale)
+        {
+            nominalSize = size;
+            delay.allocate (size * maxSizeScale);
+            delay.setLength (roundToInt (size * scale));
+            clear();
+        }
+        
+        /** Glides to a new length without touching the buffer. Realtime safe. */
+        void setScale (const float scale) noexcept      { delay.glideTo (roundToInt (nominalSize * scale)); }
+        
+        int getSize() const noexcept    { return delay.getAllocatedSize(); }
+        
+        void clear() noexcept
+        {
+            last = 0;
+            delay.clear();
+        }
+        
         void setFeedbackAndDamp (const float f, const float d) noexcept
         {
             damp1 = d;
@@ -250,20 +459,19 @@ private:
         
         inline float process (const float input) noexcept
         {
-            const float output = buffer [bufferIndex];
+            const float output = delay.read();
             last = (output * damp2) + (last * damp1);
             JUCE_UNDENORMALISE (last);
             
             float temp = input + (last * feedback);
             JUCE_UNDENORMALISE (temp);
-            buffer [bufferIndex] = temp;
-            bufferIndex = (bufferIndex + 1) % bufferSize;
+            delay.write (temp);
             return output;
         }
         
     private:
-        HeapBlock<float> buffer;
-        int bufferSize, bufferIndex;
+        GlidingDelay delay;
+        int nominalSize;
         float feedback, last, damp1, damp2;
         
         JUCE_DECLARE_NON_COPYABLE (CombFilter)
@@ -273,43 +481,43 @@ private:
     class AllPassFilter
     {
     public:
-        AllPassFilter() noexcept  : bufferSize (0), bufferIndex (0) {}
+        AllPassFilter() noexcept  : nominalSize (0) {}
         
-        void setSize (const int size)
+        /** Allocates for the largest size and starts at the given scale. Not realtime safe. */
+        void setSize (const int size, const float scale)
         {
-            if (size != bufferSize)
-            {
-                bufferIndex = 0;
-                buffer.malloc ((size_t) size);
-                bufferSize = size;
-            }
-            
-            clear();
+            nominalSize = size;
+            delay.allocate (size * maxSizeScale);
+            delay.setLength (roundToInt (size * scale));
         }
         
+        /** Glides to a new length without touching the buffer. Realtime safe. */
+        void setScale (const float scale) noexcept      { delay.glideTo (roundToInt (nominalSize * scale)); }
+        
+        int getSize() const noexcept    { return delay.getAllocatedSize(); }
+        
         void clear() noexcept
         {
-            buffer.clear ((size_t) bufferSize);
+            delay.clear();
         }
         
         inline float process (const float input) noexcept
         {
-            const float bufferedValue = buffer [bufferIndex];
+            const float bufferedValue = delay.read();
             float temp = input + (bufferedValue * 0.5f);
             JUCE_UNDENORMALISE (temp);
-            buffer [bufferIndex] = temp;
-            bufferIndex = (bufferIndex + 1) % bufferSize;
+            delay.write (temp);
             return bufferedValue - input;
         }
         
     private:
-        HeapBlock<float> buffer;
-        int bufferSize, bufferIndex;
+        GlidingDelay delay;
+        int nominalSize;
         
         JUCE_DECLARE_NON_COPYABLE (AllPassFilter)
     };
     
-    enum { numCombs = 8, numAllPasses = 4, numChannels = 2 };
+    enum { numCombs = 8, numAllPasses = 4, numChannels = 2, maxSizeScale = 2 };
     
     CombFilter comb [numChannels][numCombs];
     AllPassFilter allPass [numChannels][numAllPasses];
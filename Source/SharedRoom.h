@@ -0,0 +1,264 @@
+/*
+  ==============================================================================
+
+    SharedRoom.h
+
+    Lets several source buses share one EditReverb network. Each send bus is
+    scaled by its own send level, optionally given a set of early-reflection
+    taps, and summed into a single feed that drives the comb/allpass tail.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+ A short multi-tap delay that produces discrete early reflections for one source.
+
+ The tap pattern is a thinned-out version of Moorer's early reflection taps, with the
+ right channel offset slightly so a stereo source keeps some width before the tail.
+ */
+class EarlyReflections
+{
+public:
+    //==============================================================================
+    EarlyReflections()
+    {
+        setSampleRate (44100.0);
+    }
+
+    /** Sets the sample rate and allocates the tap lines. Not realtime safe. */
+    void setSampleRate (const double sampleRate)
+    {
+        jassert (sampleRate > 0);
+
+        static const float tapTimesMs[] = { 4.3f, 21.5f, 26.8f, 29.8f, 45.8f, 57.2f, 61.2f, 70.7f };
+        const float stereoSpreadMs = 1.7f;
+
+        for (int i = 0; i < numTaps; ++i)
+        {
+            tapDelay[0][i] = jmax (1, (int) (sampleRate * tapTimesMs[i] * 0.001));
+            tapDelay[1][i] = jmax (1, (int) (sampleRate * (tapTimesMs[i] + stereoSpreadMs) * 0.001));
+        }
+
+        bufferSize = tapDelay[1][numTaps - 1] + 1;
+
+        for (int j = 0; j < numChannels; ++j)
+            buffer[j].malloc ((size_t) bufferSize);
+
+        reset();
+    }
+
+    /** Clears the tap lines. */
+    void reset() noexcept
+    {
+        for (int j = 0; j < numChannels; ++j)
+            buffer[j].clear ((size_t) bufferSize);
+
+        bufferIndex = 0;
+    }
+
+    /** Returns the number of bytes held by the tap lines. */
+    size_t getMemoryUsage() const noexcept     { return (size_t) (numChannels * bufferSize) * sizeof (float); }
+
+    /** Pushes one channel of input through the taps, adding the reflections scaled by
+     amount onto output. Call it for every channel of the block before advanceBlock().
+     If secondInput isn't nullptr it is summed with input first, e.g. to fold a stereo
+     source into a mono network.
+     */
+    void process (const int channel, const float* const input, const float* const secondInput,
+                  float* const output, const int numSamples, const float inputGain, const float amount) noexcept
+    {
+        jassert (isPositiveAndBelow (channel, (int) numChannels));
+
+        static const float tapGains[numTaps] = { 0.841f, 0.504f, 0.379f, 0.346f, 0.272f, 0.192f, 0.217f, 0.181f };
+
+        float* const line = buffer[channel];
+        const int* const delays = tapDelay[channel];
+        int index = bufferIndex;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            line[index] = (secondInput != nullptr ? input[i] + secondInput[i] : input[i]) * inputGain;
+
+            float sum = 0;
+
+            for (int t = 0; t < numTaps; ++t)
+            {
+                int readIndex = index - delays[t];
+
+                if (readIndex < 0)
+                    readIndex += bufferSize;
+
+                sum += line[readIndex] * tapGains[t];
+            }
+
+            output[i] += sum * amount;
+
+            if (++index >= bufferSize)
+                index = 0;
+        }
+    }
+
+    /** Moves the shared write position on after all channels of a block were processed. */
+    void advanceBlock (const int numSamples) noexcept
+    {
+        bufferIndex = (bufferIndex + numSamples) % bufferSize;
+    }
+
+private:
+    //==============================================================================
+    enum { numTaps = 8, numChannels = 2 };
+
+    HeapBlock<float> buffer[numChannels];
+    int tapDelay[numChannels][numTaps];
+    int bufferSize = 0, bufferIndex = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EarlyReflections)
+};
+
+//==============================================================================
+/**
+ Sums a main input and a number of send buses into the feed for one shared reverb tail.
+
+ Call prepare() from prepareToPlay(), then for every block call beginBlock() with the
+ main input, addSend() for each enabled send bus and disableSend() for the others, and
+ hand getFeed() to EditReverb::processStereo()/processMono(). The per-source early reflections are
+ accumulated separately in getEarly(), so they can be added to the wet output at the
+ same level as the tail.
+ */
+class SharedRoom
+{
+public:
+    //==============================================================================
+    /** The number of send buses the processor exposes next to its main input. */
+    enum { numSends = 4 };
+
+    SharedRoom() {}
+
+    /** Allocates the feed and early-reflection buffers. Not realtime safe. */
+    void prepare (const double sampleRate, const int maximumBlockSize)
+    {
+        feed.setSize (numChannels, maximumBlockSize);
+        early.setSize (numChannels, maximumBlockSize);
+
+        for (int i = 0; i < numSends; ++i)
+            reflections[i].setSampleRate (sampleRate);
+
+        hasEarly = false;
+    }
+
+    /** Clears the early-reflection lines of every send. */
+    void reset() noexcept
+    {
+        for (int i = 0; i < numSends; ++i)
+            reflections[i].reset();
+    }
+
+    /** Returns the number of bytes held by the feed buffers and the early-reflection lines. */
+    size_t getMemoryUsage() const noexcept
+    {
+        size_t bytes = (size_t) (feed.getNumChannels() * feed.getNumSamples()
+                                  + early.getNumChannels() * early.getNumSamples()) * sizeof (float);
+
+        for (int i = 0; i < numSends; ++i)
+            bytes += reflections[i].getMemoryUsage();
+
+        return bytes;
+    }
+
+    /** Starts a new block, seeding the feed with the main input. */
+    void beginBlock (const AudioBuffer<float>& mainInput, const int numNetworkChannels, const int numSamples)
+    {
+        jassert (numNetworkChannels > 0 && numNetworkChannels <= numChannels);
+
+        // Only reallocates if the host goes past the block size it announced in prepareToPlay()
+        feed.setSize (numChannels, numSamples, false, false, true);
+        early.setSize (numChannels, numSamples, false, false, true);
+
+        networkChannels = numNetworkChannels;
+        hasEarly = false;
+
+        for (int ch = 0; ch < networkChannels; ++ch)
+        {
+            feed.copyFrom (ch, 0, mainInput.getReadPointer (jmin (ch, mainInput.getNumChannels() - 1)), numSamples);
+            early.clear (ch, 0, numSamples);
+        }
+    }
+
+    /** Adds one send bus to the feed.
+     A mono send goes to every network channel; a stereo send into a mono network is summed.
+     */
+    void addSend (const int sendIndex, const AudioBuffer<float>& send, const int numSamples,
+                  const float level, const float earlyAmount) noexcept
+    {
+        jassert (isPositiveAndBelow (sendIndex, (int) numSends));
+
+        const int numSendChannels = send.getNumChannels();
+
+        if (numSendChannels == 0)
+            return;
+
+        EarlyReflections& er = reflections[sendIndex];
+
+        // whatever was left in the taps when the bus was switched off is long out of date
+        if (! sendActive[sendIndex])
+        {
+            er.reset();
+            sendActive[sendIndex] = true;
+        }
+
+        for (int ch = 0; ch < networkChannels; ++ch)
+        {
+            float* const dest = feed.getWritePointer (ch);
+            const float* const input = send.getReadPointer (jmin (ch, numSendChannels - 1));
+
+            // a stereo send into a mono network is summed, for the tail and the taps alike
+            const float* const secondInput = (networkChannels == 1 && numSendChannels > 1) ? send.getReadPointer (1)
+                                                                                          : nullptr;
+
+            FloatVectorOperations::addWithMultiply (dest, input, level, numSamples);
+
+            if (secondInput != nullptr)
+                FloatVectorOperations::addWithMultiply (dest, secondInput, level, numSamples);
+
+            // the taps keep running at zero amount so that turning them up doesn't replay stale audio
+            er.process (ch, input, secondInput, early.getWritePointer (ch), numSamples, level, earlyAmount);
+        }
+
+        er.advanceBlock (numSamples);
+        hasEarly = hasEarly || earlyAmount > 0.0f;
+    }
+
+    /** Tells the room a send bus is switched off, so its early reflections start from
+     silence when it comes back. Call it every block for each disabled send. */
+    void disableSend (const int sendIndex) noexcept
+    {
+        jassert (isPositiveAndBelow (sendIndex, (int) numSends));
+        sendActive[sendIndex] = false;
+    }
+
+    /** Returns the summed network input for a channel. */
+    const float* getFeed (const int channel) const noexcept     { return feed.getReadPointer (channel); }
+
+    /** Returns the summed early reflections for a channel. */
+    const float* getEarly (const int channel) const noexcept    { return early.getReadPointer (channel); }
+
+    /** True if any send added audible early reflections this block. */
+    bool hasEarlyReflections() const noexcept                   { return hasEarly; }
+
+private:
+    //==============================================================================
+    enum { numChannels = 2 };
+
+    AudioBuffer<float> feed, early;
+    EarlyReflections reflections[numSends];
+    bool sendActive[numSends] = {};
+    int networkChannels = numChannels;
+    bool hasEarly = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SharedRoom)
+};
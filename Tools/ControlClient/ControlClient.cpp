@@ -0,0 +1,199 @@
+/*
+  ==============================================================================
+
+    ControlClient.cpp
+
+    Test client for the loopback control endpoint (see ControlEndpoint.h). It
+    sends parameter changes to a running TokyoRe:Verb instance and measures
+    how long each one takes to be applied by the audio thread. It has no JUCE
+    dependency; build it on Linux or macOS with
+
+        c++ -std=c++14 -O2 ControlClient.cpp -o ControlClient
+
+    Start the host with TOKYO_REVERB_CONTROL_PORT set (e.g. 9031), then:
+
+        ControlClient                      200 single changes to "room" on port 9031
+        ControlClient -n 1000 -p damp      1000 changes to another parameter
+        ControlClient -burst 64            also send bursts of 64 datagrams and time
+                                           how long the last one takes to land
+        ControlClient -port 9032           talk to the next instance along
+
+    The latency reported is from sending a change to seeing its sequence number
+    in an "applied" reply, so it includes the wait for the next audio block and
+    the polling interval (0.1 ms).
+
+  ==============================================================================
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Endpoint
+    {
+        int fd = -1;
+        sockaddr_in address {};
+
+        bool open (int port)
+        {
+            fd = socket (AF_INET, SOCK_DGRAM, 0);
+
+            address.sin_family = AF_INET;
+            address.sin_port = htons ((uint16_t) port);
+            address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+            return fd >= 0 && connect (fd, (const sockaddr*) &address, sizeof (address)) == 0;
+        }
+
+        void send (const std::string& text)
+        {
+            ::send (fd, text.data(), text.size(), 0);
+        }
+
+        /** Asks for the last applied sequence number, returns false on timeout. */
+        bool queryApplied (unsigned long& applied, int timeoutMs)
+        {
+            send ("?");
+
+            pollfd p { fd, POLLIN, 0 };
+
+            while (poll (&p, 1, timeoutMs) > 0)
+            {
+                char reply[64] = {};
+                const ssize_t bytes = recv (fd, reply, sizeof (reply) - 1, 0);
+
+                if (bytes > 0 && std::sscanf (reply, "applied %lu", &applied) == 1)
+                    return true;
+            }
+
+            return false;
+        }
+
+        /** Polls until the endpoint reports sequence (or later) applied. */
+        bool waitForApplied (unsigned long sequence, double timeoutSeconds)
+        {
+            const auto start = Clock::now();
+
+            while (std::chrono::duration<double> (Clock::now() - start).count() < timeoutSeconds)
+            {
+                unsigned long applied = 0;
+
+                if (queryApplied (applied, 100) && applied >= sequence)
+                    return true;
+
+                std::this_thread::sleep_for (std::chrono::microseconds (100));
+            }
+
+            return false;
+        }
+    };
+
+    void report (const char* name, std::vector<double>& latencies, int failures)
+    {
+        if (latencies.empty())
+        {
+            std::printf ("%-10s no changes were applied (%d timed out)\n", name, failures);
+            return;
+        }
+
+        std::sort (latencies.begin(), latencies.end());
+
+        auto percentile = [&latencies] (double frac)
+        {
+            return latencies[std::min (latencies.size() - 1, (size_t) (frac * (double) latencies.size()))];
+        };
+
+        double sum = 0;
+
+        for (auto l : latencies)
+            sum += l;
+
+        std::printf ("%-10s %6zu %10.3f %10.3f %10.3f %10.3f %10.3f %8d\n", name, latencies.size(),
+                     latencies.front() * 1.0e3, sum / (double) latencies.size() * 1.0e3,
+                     percentile (0.5) * 1.0e3, percentile (0.99) * 1.0e3, latencies.back() * 1.0e3, failures);
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    int port = 9031;
+    int iterations = 200;
+    int burstSize = 0;
+    std::string parameter = "room";
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp (argv[i], "-port") == 0)        port = std::atoi (argv[i + 1]);
+        else if (std::strcmp (argv[i], "-n") == 0)      iterations = std::max (1, std::atoi (argv[i + 1]));
+        else if (std::strcmp (argv[i], "-burst") == 0)  burstSize = std::max (0, std::atoi (argv[i + 1]));
+        else if (std::strcmp (argv[i], "-p") == 0)      parameter = argv[i + 1];
+    }
+
+    Endpoint endpoint;
+    unsigned long sequence = 0;
+
+    // start from whatever the instance last applied, so repeated runs don't confuse it
+    if (! endpoint.open (port) || ! endpoint.queryApplied (sequence, 1000))
+    {
+        std::fprintf (stderr, "No control endpoint answering on 127.0.0.1:%d\n", port);
+        return 1;
+    }
+
+    std::printf ("%-10s %6s %10s %10s %10s %10s %10s %8s\n",
+                 "test", "count", "min(ms)", "mean(ms)", "p50(ms)", "p99(ms)", "max(ms)", "timeouts");
+
+    std::vector<double> latencies;
+    int failures = 0;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        ++sequence;
+        const auto sent = Clock::now();
+        endpoint.send (parameter + " " + std::to_string ((i & 1) != 0 ? 0.25 : 0.75) + " " + std::to_string (sequence));
+
+        if (endpoint.waitForApplied (sequence, 1.0))
+            latencies.push_back (std::chrono::duration<double> (Clock::now() - sent).count());
+        else
+            ++failures;
+    }
+
+    report ("single", latencies, failures);
+
+    if (burstSize > 0)
+    {
+        latencies.clear();
+        failures = 0;
+
+        for (int i = 0; i < std::max (1, iterations / 10); ++i)
+        {
+            const auto sent = Clock::now();
+
+            for (int j = 0; j < burstSize; ++j)
+                endpoint.send (parameter + " " + std::to_string ((double) j / (double) burstSize) + " " + std::to_string (++sequence));
+
+            if (endpoint.waitForApplied (sequence, 1.0))
+                latencies.push_back (std::chrono::duration<double> (Clock::now() - sent).count());
+            else
+                ++failures;
+        }
+
+        report ("burst", latencies, failures);
+    }
+
+    close (endpoint.fd);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    ControlTimingCheck.cpp
+
+    Checks that a parameter change sent over the loopback control endpoint (see
+    ControlEndpoint.h) only takes effect at its sample offset. One processor
+    gets the change and an identical twin gets none; their outputs must match
+    sample for sample up to the offset, even though the host's copy of the
+    parameter has already moved to the new value before the block (as the
+    endpoint's message-thread update usually does). The exit code is non-zero
+    if the change lands early or not at all.
+
+    It sets TOKYO_REVERB_CONTROL_PORT itself, to a free loopback port, for the
+    processor under test only. Build it like Tools/HostSimulator, against the
+    plugin's shared code:
+
+        c++ -std=c++14 -O2 -I../../JuceLibraryCode -I<JUCE>/modules ControlTimingCheck.cpp \
+            ../../Builds/MacOSX/build/Release/libTokyoReVerb.a <frameworks> -o ControlTimingCheck
+
+    On Linux add JUCE's usual Linux libraries.
+
+  ==============================================================================
+*/
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/PluginProcessor.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+//==============================================================================
+static void setControlPortVariable (const String& value)
+{
+   #if JUCE_WINDOWS
+    _putenv_s ("TOKYO_REVERB_CONTROL_PORT", value.toRawUTF8());
+   #else
+    setenv ("TOKYO_REVERB_CONTROL_PORT", value.toRawUTF8(), 1);
+   #endif
+}
+
+/** Sends one change over the control endpoint to a processor while an identical twin gets
+    none, and checks that their outputs stay identical up to the change's offset. Before the
+    next block the host's copy of the parameter is moved to the new value too, as the
+    endpoint's message-thread update usually does by then; the processor must still hold
+    the old value until the offset. Returns false if the change took effect early. */
+static bool checkControlTiming()
+{
+    const double sampleRate = 48000.0;
+    const int blockSize = 4096;
+
+    int port = 0;
+
+    {
+        DatagramSocket probe (false);
+
+        if (probe.bindToPort (0, "127.0.0.1"))
+            port = probe.getBoundPort();
+    }
+
+    if (port <= 0)
+    {
+        std::printf ("skipped, no loopback socket available\n");
+        return true;
+    }
+
+    // only the second processor sees the variable, so only it gets an endpoint
+    TokyoRe_verbAudioProcessor twin;
+
+    const String previousPort (SystemStats::getEnvironmentVariable ("TOKYO_REVERB_CONTROL_PORT", "0"));
+    setControlPortVariable (String (port));
+    TokyoRe_verbAudioProcessor controlled;
+    setControlPortVariable (previousPort);
+
+    const int numChannels = jmax (twin.getTotalNumInputChannels(), twin.getTotalNumOutputChannels());
+    AudioBuffer<float> input (numChannels, blockSize), twinBlock, controlledBlock;
+    MidiBuffer midi;
+    Random random (1);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        for (int i = 0; i < blockSize; ++i)
+            input.setSample (ch, i, random.nextFloat() * 0.5f - 0.25f);
+
+    auto processBoth = [&]
+    {
+        twinBlock.makeCopyOf (input);
+        controlledBlock.makeCopyOf (input);
+        twin.processBlock (twinBlock, midi);
+        controlled.processBlock (controlledBlock, midi);
+    };
+
+    for (auto* p : { &twin, &controlled })
+    {
+        p->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        p->prepareToPlay (sampleRate, blockSize);
+    }
+
+    processBoth();
+
+    // land a little way into the block that has just been processed
+    Thread::sleep (2);
+
+    DatagramSocket sender (false);
+    const String message ("mix 1 1");
+    sender.write ("127.0.0.1", port, message.toRawUTF8(), (int) message.getNumBytesAsUTF8());
+
+    // give the endpoint's thread time to queue it, then catch the host up
+    Thread::sleep (50);
+
+    if (auto* mix = controlled.mState.getParameter ("mix"))
+        mix->setValueNotifyingHost (mix->convertTo0to1 (1.0f));
+
+    processBoth();
+
+    int firstDifference = -1;
+
+    for (int i = 0; i < blockSize && firstDifference < 0; ++i)
+        for (int ch = 0; ch < twin.getMainBusNumOutputChannels(); ++ch)
+            if (twinBlock.getSample (ch, i) != controlledBlock.getSample (ch, i))
+                firstDifference = i;
+
+    for (auto* p : { &twin, &controlled })
+        p->releaseResources();
+
+    if (firstDifference < 0)
+    {
+        std::printf ("FAILED, the change never reached the audio\n");
+        return false;
+    }
+
+    if (firstDifference == 0)
+    {
+        std::printf ("FAILED, the change took effect at the start of the block\n");
+        return false;
+    }
+
+    std::printf ("ok, old value held for %d samples until the change's offset\n", firstDifference);
+    return true;
+}
+
+//==============================================================================
+int main()
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    return checkControlTiming() ? 0 : 1;
+}
@@ -0,0 +1,501 @@
+/*
+  ==============================================================================
+
+    HostSimulator.cpp
+
+    Drives TokyoRe_verbAudioProcessor the way real hosts do rather than the way
+    benchmarks do: jittering block sizes, going past maximumBlockSize, calling
+    prepareToPlay()/releaseResources() mid-session, toggling bypass, saving and
+    restoring state during playback and automating parameters from another
+    thread. For every phase it reports the worst-case and p99 callback time and
+    how many heap allocations happened inside the audio callbacks.
+
+    It links against the plugin's shared code, so build the plugin first and
+    then, e.g. on macOS:
+
+        c++ -std=c++14 -O2 -I../../JuceLibraryCode -I<JUCE>/modules HostSimulator.cpp \
+            ../../Builds/MacOSX/build/Release/libTokyoReVerb.a \
+            -framework Accelerate -framework AudioToolbox -framework Carbon -framework Cocoa \
+            -framework CoreAudio -framework CoreMIDI -framework IOKit -framework OpenGL \
+            -framework QuartzCore -framework WebKit -o HostSimulator
+
+    On Linux the allocation counter wraps malloc/calloc/realloc at link time, so add
+
+        -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+
+    to the link line (along with the static library and JUCE's usual Linux libraries).
+    On macOS the default malloc zone is hooked at startup instead. On Windows add this
+    file to a console project that links TokyoReverb_SharedCode.lib; Debug builds count
+    every CRT allocation through _CrtSetAllocHook, Release builds only see operator new.
+
+    Usage:
+        HostSimulator                  run the built-in randomized session (seed 1)
+        HostSimulator -seed 42         run the randomized session with another seed
+        HostSimulator script.txt       replay a scripted session (see ExampleSession.txt)
+
+    A script has one command per line, '#' starts a comment:
+        prepare <sampleRate> <maxBlock>     releaseResources() if needed, then prepareToPlay()
+        release                             releaseResources()
+        process <numBlocks> <blockSize>     fixed-size blocks
+        jitter <numBlocks> <min> <max>      random block sizes in [min, max]
+        bypass <numBlocks> <blockSize>      processBlockBypassed()
+        save                                getStateInformation() on a background thread while playing
+        load                                setStateInformation() with the last saved state
+        automate <on|off>                   random parameter changes from a background thread
+        phase <name>                        starts a new phase in the report
+
+  ==============================================================================
+*/
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/PluginProcessor.h"
+
+#include <cstdio>
+#include <new>
+#include <thread>
+
+#if JUCE_MAC
+ #include <malloc/malloc.h>
+ #include <mach/mach.h>
+#elif JUCE_WINDOWS && defined (_DEBUG)
+ #include <crtdbg.h>
+#endif
+
+//==============================================================================
+// Every heap allocation goes through here, so that the ones made inside an audio
+// callback can be counted. JUCE's HeapBlock (and so AudioBuffer) allocates with
+// malloc/calloc/realloc rather than operator new, so those are hooked too wherever
+// the platform allows it.
+namespace
+{
+    thread_local bool insideCallback = false;
+    std::atomic<int64> callbackAllocations { 0 };
+
+    // Once malloc itself is counted, operator new (which calls it) mustn't count again
+    bool mallocIsCounted = false;
+
+    inline void noteAllocation() noexcept
+    {
+        if (insideCallback)
+            callbackAllocations.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    void* countedAllocate (std::size_t size)
+    {
+        if (! mallocIsCounted)
+            noteAllocation();
+
+        if (void* p = std::malloc (size == 0 ? 1 : size))
+            return p;
+
+        throw std::bad_alloc();
+    }
+
+   #if JUCE_MAC
+    void* (*zoneMalloc) (malloc_zone_t*, size_t) = nullptr;
+    void* (*zoneCalloc) (malloc_zone_t*, size_t, size_t) = nullptr;
+    void* (*zoneRealloc) (malloc_zone_t*, void*, size_t) = nullptr;
+
+    void* countedZoneMalloc (malloc_zone_t* zone, size_t size)               { noteAllocation(); return zoneMalloc (zone, size); }
+    void* countedZoneCalloc (malloc_zone_t* zone, size_t n, size_t size)     { noteAllocation(); return zoneCalloc (zone, n, size); }
+    void* countedZoneRealloc (malloc_zone_t* zone, void* p, size_t size)     { noteAllocation(); return zoneRealloc (zone, p, size); }
+   #elif JUCE_WINDOWS && defined (_DEBUG)
+    int countingAllocHook (int allocType, void*, size_t, int, long, const unsigned char*, int)
+    {
+        if (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)
+            noteAllocation();
+
+        return TRUE;
+    }
+   #endif
+
+    /** Starts counting malloc/calloc/realloc where possible, returns false if only
+        operator new can be seen. */
+    bool installMallocHooks()
+    {
+       #if JUCE_LINUX
+        return true;    // see the __wrap_ functions below
+       #elif JUCE_MAC
+        auto* zone = malloc_default_zone();
+        const auto zoneAddress = (vm_address_t) zone;
+
+        if (vm_protect (mach_task_self(), zoneAddress, sizeof (malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE) != KERN_SUCCESS)
+            return false;
+
+        zoneMalloc = zone->malloc;
+        zoneCalloc = zone->calloc;
+        zoneRealloc = zone->realloc;
+
+        zone->malloc = countedZoneMalloc;
+        zone->calloc = countedZoneCalloc;
+        zone->realloc = countedZoneRealloc;
+
+        vm_protect (mach_task_self(), zoneAddress, sizeof (malloc_zone_t), 0, VM_PROT_READ);
+        return true;
+       #elif JUCE_WINDOWS && defined (_DEBUG)
+        _CrtSetAllocHook (countingAllocHook);
+        return true;
+       #else
+        return false;
+       #endif
+    }
+}
+
+#if JUCE_LINUX
+extern "C"
+{
+    void* __real_malloc (size_t);
+    void* __real_calloc (size_t, size_t);
+    void* __real_realloc (void*, size_t);
+
+    void* __wrap_malloc (size_t size)                   { noteAllocation(); return __real_malloc (size); }
+    void* __wrap_calloc (size_t n, size_t size)         { noteAllocation(); return __real_calloc (n, size); }
+    void* __wrap_realloc (void* p, size_t size)         { noteAllocation(); return __real_realloc (p, size); }
+}
+#endif
+
+void* operator new (std::size_t size)                                   { return countedAllocate (size); }
+void* operator new[] (std::size_t size)                                 { return countedAllocate (size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept   { try { return countedAllocate (size); } catch (...) { return nullptr; } }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept { try { return countedAllocate (size); } catch (...) { return nullptr; } }
+void operator delete (void* p) noexcept                                 { std::free (p); }
+void operator delete[] (void* p) noexcept                               { std::free (p); }
+void operator delete (void* p, std::size_t) noexcept                    { std::free (p); }
+void operator delete[] (void* p, std::size_t) noexcept                  { std::free (p); }
+
+//==============================================================================
+/** Callback timings and allocation counts for one phase of the session. */
+struct PhaseStats
+{
+    String name;
+    Array<double> callbackSeconds;
+    int64 allocations = 0;
+    int oversizedBlocks = 0;
+    double worstBudgetRatio = 0;
+
+    void print() const
+    {
+        if (callbackSeconds.size() == 0)
+        {
+            std::printf ("%-24s %8s\n", name.toRawUTF8(), "idle");
+            return;
+        }
+
+        Array<double> sorted (callbackSeconds);
+        sorted.sort();
+
+        double total = 0;
+
+        for (auto s : sorted)
+            total += s;
+
+        const int p99Index = jmin (sorted.size() - 1, (int) std::ceil (0.99 * sorted.size()) - 1);
+
+        std::printf ("%-24s %8d %10.1f %10.1f %10.1f %10.2f %8d %8lld\n",
+                     name.toRawUTF8(),
+                     sorted.size(),
+                     total / sorted.size() * 1.0e6,
+                     sorted[p99Index] * 1.0e6,
+                     sorted.getLast() * 1.0e6,
+                     worstBudgetRatio,
+                     oversizedBlocks,
+                     (long long) allocations);
+    }
+};
+
+//==============================================================================
+/** Plays the role of the host around one processor instance. */
+class SimulatedHost
+{
+public:
+    SimulatedHost (int64 seed)  : random (seed)
+    {
+        processor.reset (new TokyoRe_verbAudioProcessor());
+        startPhase ("startup");
+    }
+
+    ~SimulatedHost()
+    {
+        setAutomation (false);
+
+        if (prepared)
+            processor->releaseResources();
+    }
+
+    //==============================================================================
+    void prepare (double newSampleRate, int newMaxBlock)
+    {
+        if (prepared)
+            processor->releaseResources();
+
+        sampleRate = newSampleRate;
+        maxBlock = newMaxBlock;
+
+        processor->setRateAndBufferSizeDetails (sampleRate, maxBlock);
+        processor->prepareToPlay (sampleRate, maxBlock);
+        prepared = true;
+
+        // the host's own buffer is always big enough for the oversized blocks below
+        const int numChannels = jmax (processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels());
+        buffer.setSize (numChannels, maxBlock * 8);
+    }
+
+    void release()
+    {
+        if (prepared)
+            processor->releaseResources();
+
+        prepared = false;
+    }
+
+    void process (int numBlocks, int minSize, int maxSize, bool bypassed)
+    {
+        if (! prepared)
+            prepare (44100.0, 512);
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            const int numSamples = jlimit (1, buffer.getNumSamples(),
+                                           minSize + (maxSize > minSize ? random.nextInt (maxSize - minSize + 1) : 0));
+            fillInput (numSamples);
+
+            AudioBuffer<float> block (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), numSamples);
+
+            const int64 allocationsBefore = callbackAllocations.load();
+            insideCallback = true;
+            const int64 start = Time::getHighResolutionTicks();
+
+            if (bypassed)
+                processor->processBlockBypassed (block, midi);
+            else
+                processor->processBlock (block, midi);
+
+            const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+            insideCallback = false;
+
+            current->allocations += callbackAllocations.load() - allocationsBefore;
+            current->callbackSeconds.add (seconds);
+            current->worstBudgetRatio = jmax (current->worstBudgetRatio, seconds * sampleRate / numSamples);
+
+            if (numSamples > maxBlock)
+                ++current->oversizedBlocks;
+        }
+    }
+
+    //==============================================================================
+    /** Saves state on another thread while the audio keeps running, like an autosave. */
+    void saveDuringPlayback()
+    {
+        std::atomic<bool> done { false };
+
+        std::thread saver ([this, &done]
+        {
+            processor->getStateInformation (savedState);
+            done = true;
+        });
+
+        while (! done)
+            process (1, maxBlock, maxBlock, false);
+
+        saver.join();
+    }
+
+    void load()
+    {
+        if (savedState.getSize() > 0)
+            processor->setStateInformation (savedState.getData(), (int) savedState.getSize());
+    }
+
+    void setAutomation (bool shouldRun)
+    {
+        if (shouldRun == (automation != nullptr))
+            return;
+
+        if (shouldRun)
+        {
+            stopAutomation = false;
+
+            automation.reset (new std::thread ([this]
+            {
+                Random r (1234);
+                auto& params = processor->getParameters();
+
+                while (! stopAutomation)
+                {
+                    if (params.size() > 0)
+                        params[r.nextInt (params.size())]->setValueNotifyingHost (r.nextFloat());
+
+                    Thread::sleep (1);
+                }
+            }));
+        }
+        else
+        {
+            stopAutomation = true;
+            automation->join();
+            automation.reset();
+        }
+    }
+
+    //==============================================================================
+    void startPhase (const String& name)
+    {
+        phases.add (new PhaseStats());
+        current = phases.getLast();
+        current->name = name;
+    }
+
+    void printReport() const
+    {
+        std::printf ("%-24s %8s %10s %10s %10s %10s %8s %8s\n",
+                     "phase", "blocks", "mean(us)", "p99(us)", "worst(us)", "worst/bud", "oversize", "allocs");
+
+        for (auto* p : phases)
+            p->print();
+    }
+
+    int getMaxBlock() const noexcept        { return maxBlock; }
+
+private:
+    void fillInput (int numSamples)
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto* data = buffer.getWritePointer (ch);
+
+            for (int i = 0; i < numSamples; ++i)
+                data[i] = random.nextFloat() * 0.5f - 0.25f;
+        }
+    }
+
+    std::unique_ptr<TokyoRe_verbAudioProcessor> processor;
+    Random random;
+    AudioBuffer<float> buffer;
+    MidiBuffer midi;
+    MemoryBlock savedState;
+
+    double sampleRate = 44100.0;
+    int maxBlock = 512;
+    bool prepared = false;
+
+    std::unique_ptr<std::thread> automation;
+    std::atomic<bool> stopAutomation { false };
+
+    OwnedArray<PhaseStats> phases;
+    PhaseStats* current = nullptr;
+};
+
+//==============================================================================
+static void runScript (SimulatedHost& host, const File& script)
+{
+    StringArray lines;
+    lines.addLines (script.loadFileAsString());
+
+    for (auto line : lines)
+    {
+        line = line.upToFirstOccurrenceOf ("#", false, false).trim();
+
+        if (line.isEmpty())
+            continue;
+
+        const auto tokens = StringArray::fromTokens (line, false);
+        const auto& command = tokens[0];
+
+        if      (command == "prepare")  host.prepare (tokens[1].getDoubleValue(), tokens[2].getIntValue());
+        else if (command == "release")  host.release();
+        else if (command == "process")  host.process (tokens[1].getIntValue(), tokens[2].getIntValue(), tokens[2].getIntValue(), false);
+        else if (command == "jitter")   host.process (tokens[1].getIntValue(), tokens[2].getIntValue(), tokens[3].getIntValue(), false);
+        else if (command == "bypass")   host.process (tokens[1].getIntValue(), tokens[2].getIntValue(), tokens[2].getIntValue(), true);
+        else if (command == "save")     host.saveDuringPlayback();
+        else if (command == "load")     host.load();
+        else if (command == "automate") host.setAutomation (tokens[1] == "on");
+        else if (command == "phase")    host.startPhase (tokens[1]);
+        else                            std::printf ("unknown command: %s\n", line.toRawUTF8());
+    }
+}
+
+static void runRandomSession (SimulatedHost& host, int64 seed)
+{
+    Random random (seed);
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+    const int blockSizes[] = { 64, 128, 256, 441, 512, 1024 };
+
+    host.startPhase ("fixed 512");
+    host.prepare (44100.0, 512);
+    host.process (2000, 512, 512, false);
+
+    host.startPhase ("jittered sizes");
+    host.process (2000, 1, 512, false);
+
+    host.startPhase ("past maxBlockSize");
+    host.process (200, 513, 512 * 4, false);
+
+    host.startPhase ("bypass toggling");
+
+    for (int i = 0; i < 50; ++i)
+        host.process (random.nextInt (20) + 1, 512, 512, random.nextBool());
+
+    host.startPhase ("save during playback");
+
+    for (int i = 0; i < 50; ++i)
+    {
+        host.saveDuringPlayback();
+        host.process (20, 512, 512, false);
+    }
+
+    host.startPhase ("automation + load");
+    host.setAutomation (true);
+
+    for (int i = 0; i < 50; ++i)
+    {
+        host.process (40, 1, 512, false);
+        host.load();
+    }
+
+    host.setAutomation (false);
+
+    host.startPhase ("re-prepare mid-session");
+
+    for (int i = 0; i < 20; ++i)
+    {
+        if (random.nextInt (3) == 0)
+            host.release();
+
+        host.prepare (sampleRates[random.nextInt (3)], blockSizes[random.nextInt (6)]);
+        host.process (100, 1, host.getMaxBlock(), false);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    mallocIsCounted = installMallocHooks();
+
+    if (! mallocIsCounted)
+        std::printf ("Note: only operator new is counted in this build, HeapBlock/AudioBuffer allocations are not.\n\n");
+
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    int64 seed = 1;
+    File script;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const String arg (argv[i]);
+
+        if (arg == "-seed" && i + 1 < argc)
+            seed = String (argv[++i]).getLargeIntValue();
+        else
+            script = File::getCurrentWorkingDirectory().getChildFile (arg);
+    }
+
+    SimulatedHost host (seed);
+
+    if (script.existsAsFile())
+        runScript (host, script);
+    else
+        runRandomSession (host, seed);
+
+    host.printReport();
+    return 0;
+}
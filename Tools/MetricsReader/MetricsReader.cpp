@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    MetricsReader.cpp
+
+    Tiny command-line reader for the shared-memory metrics published by
+    MetricsExporter. It has no JUCE dependency; build it on Linux or macOS with
+
+        c++ -std=c++14 -O2 -I../../Source MetricsReader.cpp -o MetricsReader
+
+    (add -lrt on older glibc). Run it with segment names such as
+    /tokyoreverb-1234-0, or with no names on Linux to read every TokyoRe:Verb
+    segment in /dev/shm. Pass -w to refresh once a second.
+
+  ==============================================================================
+*/
+
+#include "MetricsLayout.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined (__linux__)
+ #include <dirent.h>
+#endif
+
+namespace
+{
+    /** Copies a segment with the seqlock protocol described in MetricsLayout.h. */
+    bool readSegment (const std::string& name, TokyoReverbMetrics::Block& copy)
+    {
+        const int fd = shm_open (name.c_str(), O_RDONLY, 0);
+
+        if (fd < 0)
+            return false;
+
+        void* mapped = mmap (nullptr, sizeof (TokyoReverbMetrics::Block), PROT_READ, MAP_SHARED, fd, 0);
+        close (fd);
+
+        if (mapped == MAP_FAILED)
+            return false;
+
+        const auto* block = static_cast<const TokyoReverbMetrics::Block*> (mapped);
+        bool ok = false;
+
+        for (int attempt = 0; attempt < 100 && ! ok; ++attempt)
+        {
+            const uint32_t before = block->sequence.load (std::memory_order_acquire);
+
+            if ((before & 1) != 0)
+                continue;
+
+            std::memcpy (static_cast<void*> (&copy), block, sizeof (TokyoReverbMetrics::Block));
+            std::atomic_thread_fence (std::memory_order_acquire);
+
+            ok = block->sequence.load (std::memory_order_relaxed) == before;
+        }
+
+        munmap (mapped, sizeof (TokyoReverbMetrics::Block));
+
+        return ok && std::memcmp (copy.magic, TokyoReverbMetrics::blockMagic, sizeof (copy.magic)) == 0
+                  && copy.version == TokyoReverbMetrics::layoutVersion;
+    }
+
+    std::vector<std::string> findSegments()
+    {
+        std::vector<std::string> names;
+
+       #if defined (__linux__)
+        const char* prefix = TokyoReverbMetrics::segmentPrefix + 1;   // /dev/shm entries have no leading slash
+
+        if (DIR* dir = opendir ("/dev/shm"))
+        {
+            while (dirent* entry = readdir (dir))
+                if (std::strncmp (entry->d_name, prefix, std::strlen (prefix)) == 0)
+                    names.push_back (std::string ("/") + entry->d_name);
+
+            closedir (dir);
+        }
+       #endif
+
+        return names;
+    }
+
+    void printAll (const std::vector<std::string>& requested)
+    {
+        const std::vector<std::string> names = requested.empty() ? findSegments() : requested;
+
+        std::printf ("%-28s %8s %8s %10s %10s %10s %12s %10s\n",
+                     "segment", "cpu%", "sleep%", "p99(us)", "max(us)", "xrunRisk", "blocks", "mem(KiB)");
+
+        for (const auto& name : names)
+        {
+            TokyoReverbMetrics::Block b;
+
+            if (! readSegment (name, b))
+            {
+                std::printf ("%-28s unreadable\n", name.c_str());
+                continue;
+            }
+
+            std::printf ("%-28s %8.3f %8.3f %10.1f %10.1f %10llu %12llu %10.1f\n",
+                         name.c_str(),
+                         b.cpuLoad * 100.0,
+                         b.sleepRatio * 100.0,
+                         b.p99BlockSeconds * 1.0e6,
+                         b.maxBlockSeconds * 1.0e6,
+                         (unsigned long long) b.xrunRisks,
+                         (unsigned long long) b.blocks,
+                         (double) b.memoryBytes / 1024.0);
+        }
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    bool watch = false;
+    std::vector<std::string> names;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp (argv[i], "-w") == 0)
+            watch = true;
+        else
+            names.push_back (argv[i]);
+    }
+
+    do
+    {
+        printAll (names);
+
+        if (watch)
+        {
+            std::printf ("\n");
+            sleep (1);
+        }
+    }
+    while (watch);
+
+    return 0;
+}
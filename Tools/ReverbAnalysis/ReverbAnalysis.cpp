@@ -0,0 +1,530 @@
+/*
+  ==============================================================================
+
+    ReverbAnalysis.cpp
+
+    Renders a set of standard stimuli through every reverb engine/configuration
+    in the tree and prints objective quality metrics next to the measured cost,
+    marking the configurations that sit on the Pareto front of cost against
+    fidelity to the reference only (see markParetoFront()).
+
+    Quality metrics (all on the wet signal, width 1, room 0.5, damp 0.5):
+      - mixing time: when the normalised echo density of the impulse response
+        (Abel & Huang) first reaches 1, i.e. the tail has become noise-like
+      - flatness: spectral flatness of the impulse response tail (100-600ms),
+        1.0 is perfectly flat
+      - modes/Hz: spectral peaks per Hz in the tail between 100Hz and 5kHz
+      - noise floor: level of the difference to the reference EditReverb fp32
+        render of the same stimuli, relative to the reference, in dB
+
+    Cost metrics (the Pareto front ranks on the first and last):
+      - ns/sample: processing time per sample frame for the whole configuration
+      - ns/sample/source: the same divided by the number of sources fed into the
+        room, for information only - the shared-room configurations count their
+        silent sends as sources too
+      - bytes: memory held by the configuration's DSP state
+
+    Build it like Tools/HostSimulator, against the plugin's shared code:
+
+        c++ -std=c++14 -O2 -I../../JuceLibraryCode -I<JUCE>/modules ReverbAnalysis.cpp \
+            ../../Builds/MacOSX/build/Release/libTokyoReVerb.a <frameworks> -o ReverbAnalysis
+
+    Usage:
+        ReverbAnalysis [-rate 48000] [-csv results.csv]
+
+  ==============================================================================
+*/
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/Reverb_Edit.h"
+#include "../../Source/SharedRoom.h"
+
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+//==============================================================================
+/** One way of producing a reverb tail from a stereo stimulus. */
+struct Engine
+{
+    virtual ~Engine() {}
+
+    virtual void prepare (double sampleRate, int maxBlock) = 0;
+
+    /** Replaces left/right with the wet signal only. */
+    virtual void process (float* left, float* right, int numSamples) = 0;
+
+    virtual size_t getMemoryUsage() const = 0;
+
+    /** How many sources share the room, for the per-source time column. */
+    virtual int getNumSources() const   { return 1; }
+
+    /** How many of the output channels are comparable to the reference. */
+    virtual int getNumOutputChannels() const   { return 2; }
+
+    static EditReverb::Parameters wetOnly()
+    {
+        EditReverb::Parameters p;
+        p.roomSize = 0.5f;
+        p.damping = 0.5f;
+        p.width = 1.0f;
+        p.wetLevel = 1.0f;
+        p.dryLevel = 0.0f;
+        return p;
+    }
+};
+
+struct EditReverbStereo  : public Engine
+{
+    EditReverbStereo (float sizeToUse = 1.0f)  : size (sizeToUse) {}
+
+    void prepare (double sampleRate, int) override
+    {
+        auto p = wetOnly();
+        p.size = size;
+
+        // parameters first, so the delay lines start at their scaled length instead of gliding there
+        reverb.setParameters (p);
+        reverb.setSampleRate (sampleRate);
+        reverb.reset();
+    }
+
+    void process (float* left, float* right, int numSamples) override  { reverb.processStereo (left, right, numSamples); }
+    size_t getMemoryUsage() const override                           { return sizeof (*this) + reverb.getMemoryUsage(); }
+
+    float size;
+    EditReverb reverb;
+};
+
+struct EditReverbMono  : public Engine
+{
+    void prepare (double sampleRate, int) override
+    {
+        reverb.setSampleRate (sampleRate);
+        reverb.setParameters (wetOnly());
+        reverb.reset();
+    }
+
+    // Fed with left + right and at width 1, the mono network is exactly the left half of
+    // the stereo one, so only that channel is compared against the reference
+    void process (float* left, float* right, int numSamples) override
+    {
+        FloatVectorOperations::add (left, right, numSamples);
+        reverb.processMono (left, numSamples);
+        FloatVectorOperations::clear (right, numSamples);
+    }
+
+    size_t getMemoryUsage() const override  { return sizeof (*this) + reverb.getMemoryUsage(); }
+    int getNumOutputChannels() const override   { return 1; }
+
+    EditReverb reverb;
+};
+
+struct JuceReverbStereo  : public Engine
+{
+    void prepare (double sampleRate, int) override
+    {
+        Reverb::Parameters p;
+        const auto e = wetOnly();
+        p.roomSize = e.roomSize;
+        p.damping = e.damping;
+        p.width = e.width;
+        p.wetLevel = e.wetLevel;
+        p.dryLevel = e.dryLevel;
+
+        reverb.setSampleRate (sampleRate);
+        reverb.setParameters (p);
+        reverb.reset();
+
+        bufferBytes = getFreeVerbBufferBytes (sampleRate);
+    }
+
+    void process (float* left, float* right, int numSamples) override  { reverb.processStereo (left, right, numSamples); }
+    size_t getMemoryUsage() const override                           { return sizeof (*this) + bufferBytes; }
+
+    /** juce::Reverb doesn't expose its buffers, but it sizes them from the FreeVerb tunings
+        exactly as juce::Reverb::setSampleRate() (and EditReverb before the Size parameter) does. */
+    static size_t getFreeVerbBufferBytes (double sampleRate)
+    {
+        static const short combTunings[] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+        static const short allPassTunings[] = { 556, 441, 341, 225 };
+        const int stereoSpread = 23;
+        const int intSampleRate = (int) sampleRate;
+        size_t numFloats = 0;
+
+        for (auto tuning : combTunings)
+            numFloats += (size_t) ((intSampleRate * tuning) / 44100 + (intSampleRate * (tuning + stereoSpread)) / 44100);
+
+        for (auto tuning : allPassTunings)
+            numFloats += (size_t) ((intSampleRate * tuning) / 44100 + (intSampleRate * (tuning + stereoSpread)) / 44100);
+
+        return numFloats * sizeof (float);
+    }
+
+    Reverb reverb;
+    size_t bufferBytes = 0;
+};
+
+/** The plugin's shared-room mode: the stimulus arrives on send 1, the main input and the
+    other sends are silent but still summed into the one network. */
+struct SharedRoomSends  : public Engine
+{
+    SharedRoomSends (float earlyAmountToUse)  : earlyAmount (earlyAmountToUse) {}
+
+    void prepare (double sampleRate, int maxBlock) override
+    {
+        reverb.setSampleRate (sampleRate);
+        reverb.setParameters (wetOnly());
+        reverb.reset();
+        room.prepare (sampleRate, maxBlock);
+        room.reset();
+        silence.setSize (2, maxBlock);
+        silence.clear();
+        send.setSize (2, maxBlock);
+    }
+
+    void process (float* left, float* right, int numSamples) override
+    {
+        send.copyFrom (0, 0, left, numSamples);
+        send.copyFrom (1, 0, right, numSamples);
+
+        AudioBuffer<float> main (silence.getArrayOfWritePointers(), 2, numSamples);
+        AudioBuffer<float> send1 (send.getArrayOfWritePointers(), 2, numSamples);
+
+        room.beginBlock (main, 2, numSamples);
+
+        for (int i = 0; i < SharedRoom::numSends; ++i)
+            room.addSend (i, i == 0 ? send1 : main, numSamples, 1.0f, i == 0 ? earlyAmount : 0.0f);
+
+        FloatVectorOperations::clear (left, numSamples);
+        FloatVectorOperations::clear (right, numSamples);
+        reverb.processStereo (left, right, room.getFeed (0), room.getFeed (1), numSamples);
+
+        if (room.hasEarlyReflections())
+        {
+            FloatVectorOperations::addWithMultiply (left, room.getEarly (0), reverb.getWetGain(), numSamples);
+            FloatVectorOperations::addWithMultiply (right, room.getEarly (1), reverb.getWetGain(), numSamples);
+        }
+    }
+
+    size_t getMemoryUsage() const override  { return sizeof (*this) + reverb.getMemoryUsage() + room.getMemoryUsage(); }
+    int getNumSources() const override      { return 1 + SharedRoom::numSends; }
+
+    const float earlyAmount;
+    EditReverb reverb;
+    SharedRoom room;
+    AudioBuffer<float> silence, send;
+};
+
+//==============================================================================
+/** Quality and cost figures for one configuration. */
+struct Result
+{
+    String name;
+    double nsPerSample = 0, nsPerSamplePerSource = 0, bytes = 0;
+    double mixingTimeMs = 0, flatness = 0, modesPerHz = 0, noiseFloorDb = 0;
+    bool pareto = false;
+};
+
+//==============================================================================
+class Analyser
+{
+public:
+    Analyser (double rate)  : sampleRate (rate)
+    {
+        const int length = (int) (sampleRate * 2.0);
+        Random random (1);
+
+        impulse.setSize (2, length);
+        impulse.clear();
+        impulse.setSample (0, 0, 1.0f);
+        impulse.setSample (1, 0, 1.0f);
+
+        // half a second of noise followed by a sine sweep, then silence for the tail
+        program.setSize (2, length);
+        program.clear();
+
+        for (int i = 0; i < length / 4; ++i)
+        {
+            program.setSample (0, i, random.nextFloat() - 0.5f);
+            program.setSample (1, i, random.nextFloat() - 0.5f);
+        }
+
+        for (int i = length / 4; i < length / 2; ++i)
+        {
+            const double t = (i - length / 4) / sampleRate;
+            const float s = 0.5f * (float) std::sin (MathConstants<double>::twoPi * 50.0 * std::pow (200.0, t * 2.0) * t);
+            program.setSample (0, i, s);
+            program.setSample (1, i, s);
+        }
+    }
+
+    Result analyse (const String& name, Engine& engine, const AudioBuffer<float>* reference)
+    {
+        Result r;
+        r.name = name;
+
+        const AudioBuffer<float> ir = render (engine, impulse);
+        r.mixingTimeMs = mixingTimeMs (ir);
+        analyseTailSpectrum (ir, r.flatness, r.modesPerHz);
+
+        const AudioBuffer<float> out = render (engine, program);
+        r.noiseFloorDb = reference != nullptr ? noiseFloorDb (out, *reference, engine.getNumOutputChannels()) : -std::numeric_limits<double>::infinity();
+
+        r.nsPerSample = measureCost (engine);
+        r.nsPerSamplePerSource = r.nsPerSample / engine.getNumSources();
+        r.bytes = (double) engine.getMemoryUsage();
+
+        return r;
+    }
+
+    AudioBuffer<float> renderProgram (Engine& engine)     { return render (engine, program); }
+
+private:
+    enum { blockSize = 512, fftOrder = 14 };
+
+    AudioBuffer<float> render (Engine& engine, const AudioBuffer<float>& input)
+    {
+        AudioBuffer<float> out (input);
+        engine.prepare (sampleRate, blockSize);
+
+        for (int pos = 0; pos < out.getNumSamples(); pos += blockSize)
+        {
+            const int n = jmin ((int) blockSize, out.getNumSamples() - pos);
+            engine.process (out.getWritePointer (0, pos), out.getWritePointer (1, pos), n);
+        }
+
+        return out;
+    }
+
+    double measureCost (Engine& engine)
+    {
+        AudioBuffer<float> work (2, blockSize);
+        const int numBlocks = (int) (sampleRate * 10.0) / blockSize;
+        double best = std::numeric_limits<double>::max();
+
+        engine.prepare (sampleRate, blockSize);
+
+        for (int run = 0; run < 5; ++run)
+        {
+            const int64 start = Time::getHighResolutionTicks();
+
+            for (int b = 0; b < numBlocks; ++b)
+            {
+                work.copyFrom (0, 0, program, 0, (b * blockSize) % (program.getNumSamples() - blockSize), blockSize);
+                work.copyFrom (1, 0, program, 1, (b * blockSize) % (program.getNumSamples() - blockSize), blockSize);
+                engine.process (work.getWritePointer (0), work.getWritePointer (1), blockSize);
+            }
+
+            const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+            best = jmin (best, seconds * 1.0e9 / (numBlocks * blockSize));
+        }
+
+        return best;
+    }
+
+    /** Normalised echo density over a 20ms window, returns when it first reaches 1. */
+    double mixingTimeMs (const AudioBuffer<float>& ir) const
+    {
+        const float* h = ir.getReadPointer (0);
+        const int window = (int) (0.02 * sampleRate);
+        const double erfcNorm = 1.0 / std::erfc (1.0 / std::sqrt (2.0));
+
+        for (int start = 0; start + window < ir.getNumSamples(); start += window / 4)
+        {
+            double energy = 0;
+
+            for (int i = start; i < start + window; ++i)
+                energy += (double) h[i] * h[i];
+
+            const double sigma = std::sqrt (energy / window);
+
+            if (sigma <= 0)
+                continue;
+
+            int outliers = 0;
+
+            for (int i = start; i < start + window; ++i)
+                if (std::abs (h[i]) > sigma)
+                    ++outliers;
+
+            if (outliers * erfcNorm / window >= 1.0)
+                return (start + window / 2) * 1000.0 / sampleRate;
+        }
+
+        return std::numeric_limits<double>::infinity();
+    }
+
+    void analyseTailSpectrum (const AudioBuffer<float>& ir, double& flatness, double& modesPerHz) const
+    {
+        const int fftSize = 1 << fftOrder;
+        const int start = (int) (0.1 * sampleRate);
+        const int length = jmin ((int) (0.5 * sampleRate), fftSize, ir.getNumSamples() - start);
+
+        std::vector<float> data ((size_t) fftSize * 2, 0.0f);
+
+        for (int i = 0; i < length; ++i)
+        {
+            const float hann = 0.5f - 0.5f * std::cos (MathConstants<float>::twoPi * i / (length - 1));
+            data[(size_t) i] = ir.getSample (0, start + i) * hann;
+        }
+
+        dsp::FFT fft (fftOrder);
+        fft.performFrequencyOnlyForwardTransform (data.data());
+
+        const double binHz = sampleRate / fftSize;
+        const int lowBin = (int) (100.0 / binHz), highBin = jmin ((int) (5000.0 / binHz), fftSize / 2 - 1);
+
+        double logSum = 0, sum = 0, peak = 0;
+
+        for (int b = lowBin; b <= highBin; ++b)
+        {
+            const double power = (double) data[(size_t) b] * data[(size_t) b] + 1.0e-30;
+            logSum += std::log (power);
+            sum += power;
+            peak = jmax (peak, power);
+        }
+
+        const int numBins = highBin - lowBin + 1;
+        flatness = std::exp (logSum / numBins) / (sum / numBins);
+
+        // peaks within 30dB of the strongest one count as modes
+        int modes = 0;
+
+        for (int b = lowBin + 1; b < highBin; ++b)
+        {
+            const double m = data[(size_t) b];
+
+            if (m > data[(size_t) b - 1] && m >= data[(size_t) b + 1] && m * m > peak * 1.0e-3)
+                ++modes;
+        }
+
+        modesPerHz = modes / ((highBin - lowBin) * binHz);
+    }
+
+    static double noiseFloorDb (const AudioBuffer<float>& out, const AudioBuffer<float>& reference, int numChannels)
+    {
+        double residual = 0, signal = 0;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const float* a = out.getReadPointer (ch);
+            const float* b = reference.getReadPointer (ch);
+
+            for (int i = 0; i < out.getNumSamples(); ++i)
+            {
+                residual += square ((double) a[i] - b[i]);
+                signal += square ((double) b[i]);
+            }
+        }
+
+        if (residual <= 0)
+            return -std::numeric_limits<double>::infinity();
+
+        return 10.0 * std::log10 (residual / jmax (signal, 1.0e-30));
+    }
+
+    const double sampleRate;
+    AudioBuffer<float> impulse, program;
+};
+
+//==============================================================================
+/** A configuration is on the front if no other one is at least as cheap in time and
+    memory and at least as close to the reference, while being strictly better in one.
+
+    The only quality axis is the residual against the reference render, so this is a front
+    of cost vs fidelity to the reference, not of perceived quality: a configuration that
+    sounds different on purpose (another size, juce::Reverb) scores as worse, and the
+    reference itself is always on it. Mixing time, flatness and modes/Hz are reported
+    alongside but don't take part. */
+static void markParetoFront (std::vector<Result>& results)
+{
+    for (auto& a : results)
+    {
+        a.pareto = true;
+
+        for (auto& b : results)
+        {
+            if (&a == &b)
+                continue;
+
+            const bool noWorse  = b.nsPerSample <= a.nsPerSample && b.bytes <= a.bytes && b.noiseFloorDb <= a.noiseFloorDb;
+            const bool better   = b.nsPerSample <  a.nsPerSample || b.bytes <  a.bytes || b.noiseFloorDb <  a.noiseFloorDb;
+
+            if (noWorse && better)
+            {
+                a.pareto = false;
+                break;
+            }
+        }
+    }
+}
+
+static String formatDb (double db)
+{
+    return std::isinf (db) ? String ("exact") : String (db, 1);
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    double sampleRate = 48000.0;
+    File csvFile;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const String arg (argv[i]);
+
+        if (arg == "-rate")     sampleRate = String (argv[i + 1]).getDoubleValue();
+        else if (arg == "-csv") csvFile = File::getCurrentWorkingDirectory().getChildFile (argv[i + 1]);
+    }
+
+    Analyser analyser (sampleRate);
+
+    EditReverbStereo reference;
+    const AudioBuffer<float> referenceRender = analyser.renderProgram (reference);
+
+    struct Config { const char* name; std::unique_ptr<Engine> engine; };
+    std::vector<Config> configs;
+    configs.push_back ({ "EditReverb fp32 stereo (ref)", std::unique_ptr<Engine> (new EditReverbStereo()) });
+    configs.push_back ({ "EditReverb fp32 mono",         std::unique_ptr<Engine> (new EditReverbMono()) });
+    configs.push_back ({ "EditReverb size 0.5",          std::unique_ptr<Engine> (new EditReverbStereo (0.5f)) });
+    configs.push_back ({ "EditReverb size 2",            std::unique_ptr<Engine> (new EditReverbStereo (2.0f)) });
+    configs.push_back ({ "juce::Reverb stereo",          std::unique_ptr<Engine> (new JuceReverbStereo()) });
+    configs.push_back ({ "SharedRoom 5 sources",         std::unique_ptr<Engine> (new SharedRoomSends (0.0f)) });
+    configs.push_back ({ "SharedRoom 5 sources + early", std::unique_ptr<Engine> (new SharedRoomSends (1.0f)) });
+
+    std::vector<Result> results;
+
+    for (auto& c : configs)
+        results.push_back (analyser.analyse (c.name, *c.engine, &referenceRender));
+
+    markParetoFront (results);
+
+    std::printf ("%-30s %10s %10s %10s %10s %10s %10s %12s %7s\n",
+                 "configuration", "ns/smp", "ns/smp/src", "bytes", "mix(ms)", "flatness", "modes/Hz", "floor(dB)", "pareto");
+
+    String csv ("configuration,ns_per_sample,ns_per_sample_per_source,bytes,mixing_time_ms,flatness,modes_per_hz,noise_floor_db,pareto\n");
+
+    for (auto& r : results)
+    {
+        std::printf ("%-30s %10.2f %10.2f %10.0f %10.1f %10.3f %10.4f %12s %7s\n",
+                     r.name.toRawUTF8(), r.nsPerSample, r.nsPerSamplePerSource, r.bytes, r.mixingTimeMs, r.flatness,
+                     r.modesPerHz, formatDb (r.noiseFloorDb).toRawUTF8(), r.pareto ? "*" : "");
+
+        csv << r.name << "," << String (r.nsPerSample, 3) << "," << String (r.nsPerSamplePerSource, 3) << ","
+            << String ((int64) r.bytes) << ","
+            << String (r.mixingTimeMs, 2) << "," << String (r.flatness, 4) << "," << String (r.modesPerHz, 5) << ","
+            << formatDb (r.noiseFloorDb) << "," << (r.pareto ? "1" : "0") << "\n";
+    }
+
+    std::printf ("\npareto: cost per configuration (ns/smp, bytes) vs fidelity to the reference (floor) only;\n"
+                 "        ns/smp/src, mix, flatness and modes/Hz are not part of it\n");
+
+    if (csvFile != File())
+        csvFile.replaceWithText (csv);
+
+    return 0;
+}